@@ -0,0 +1,56 @@
+#ifndef _ALINE_ALIGNED_H_
+#define _ALINE_ALIGNED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace aline {
+
+    // allocator returning storage aligned on Alignment bytes, so that SIMD
+    // kernels can use aligned loads on the streams of a mesh
+    template <class T, size_t Alignment = 32>
+    class AlignedAllocator {
+        public:
+            using value_type = T;
+
+            template <class U> struct rebind {
+                using other = AlignedAllocator<U, Alignment>;
+            };
+
+            AlignedAllocator() {}
+
+            template <class U> AlignedAllocator( const AlignedAllocator<U, Alignment> & ) {}
+
+            // the pointer returned by operator new is stored just before the
+            // aligned block to be given back in deallocate()
+            T * allocate( size_t n ) {
+                size_t size = n * sizeof(T) + Alignment + sizeof(void *);
+                void * raw = ::operator new(size);
+                uintptr_t address = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+                address = (address + Alignment - 1) & ~(uintptr_t) (Alignment - 1);
+                reinterpret_cast<void **>(address)[-1] = raw;
+                return reinterpret_cast<T *>(address);
+            }
+
+            void deallocate( T * p, size_t ) {
+                ::operator delete(reinterpret_cast<void **>(p)[-1]);
+            }
+    };
+
+    template <class T, class U, size_t A>
+    bool operator==( const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> & ) {
+        return true;
+    }
+
+    template <class T, class U, size_t A>
+    bool operator!=( const AlignedAllocator<T, A> &, const AlignedAllocator<U, A> & ) {
+        return false;
+    }
+
+    template <class T>
+    using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+}
+
+#endif // _ALINE_ALIGNED_H_
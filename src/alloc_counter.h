@@ -0,0 +1,64 @@
+#ifndef _ALINE_ALLOC_COUNTER_H_
+#define _ALINE_ALLOC_COUNTER_H_
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace aline {
+    namespace memory {
+
+        // number of calls to the global operator new so far; it only counts
+        // when ALINE_COUNT_ALLOCATIONS is defined in the program
+        inline std::atomic<unsigned long> & allocation_counter() {
+            static std::atomic<unsigned long> count { 0 };
+            return count;
+        }
+
+        inline unsigned long allocation_count() {
+            return allocation_counter().load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// replacement of the global allocation functions, to be defined in exactly
+// one translation unit of the program, before including this header; kept
+// out of line so that GCC does not pair an inlined free() with operator new
+#ifdef ALINE_COUNT_ALLOCATIONS
+
+#if defined(__GNUC__)
+#define ALINE_NOINLINE __attribute__((noinline))
+#else
+#define ALINE_NOINLINE
+#endif
+
+ALINE_NOINLINE void * operator new( std::size_t size ) {
+    aline::memory::allocation_counter().fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+ALINE_NOINLINE void * operator new[]( std::size_t size ) {
+    return ::operator new(size);
+}
+
+ALINE_NOINLINE void operator delete( void * p ) noexcept {
+    std::free(p);
+}
+
+ALINE_NOINLINE void operator delete[]( void * p ) noexcept {
+    std::free(p);
+}
+
+ALINE_NOINLINE void operator delete( void * p, std::size_t ) noexcept {
+    std::free(p);
+}
+
+ALINE_NOINLINE void operator delete[]( void * p, std::size_t ) noexcept {
+    std::free(p);
+}
+
+#endif // ALINE_COUNT_ALLOCATIONS
+
+#endif // _ALINE_ALLOC_COUNTER_H_
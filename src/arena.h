@@ -0,0 +1,82 @@
+#ifndef _ALINE_ARENA_H_
+#define _ALINE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace aline {
+
+    // bump allocator for memory that only lives for one frame; reset() frees
+    // everything at once. When a frame needs more than the current block,
+    // the extra is served from overflow blocks and the next reset() grows the
+    // block to the high-water mark, so a steady state never touches the heap
+    class FrameArena {
+        private:
+            unsigned char * block;
+            size_t capacity;
+            size_t offset;
+            std::vector<unsigned char *> overflow;
+            size_t overflow_size;
+
+            void release_overflow() {
+                for (unsigned char * extra : overflow)
+                    delete[] extra;
+                overflow.clear();
+                overflow_size = 0;
+            }
+
+        public:
+            FrameArena( size_t capacity = 1 << 16 ) {
+                block = new unsigned char[capacity];
+                this->capacity = capacity;
+                offset = 0;
+                overflow_size = 0;
+            }
+
+            ~FrameArena() {
+                release_overflow();
+                delete[] block;
+            }
+
+            FrameArena( const FrameArena & ) = delete;
+            FrameArena & operator=( const FrameArena & ) = delete;
+
+            // uninitialised storage for n objects of trivial type T
+            template <class T> T * allocate( size_t n ) {
+                size_t aligned = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+                size_t size = n * sizeof(T);
+                if (aligned + size <= capacity) {
+                    offset = aligned + size;
+                    return reinterpret_cast<T *>(block + aligned);
+                }
+                unsigned char * extra = new unsigned char[size + alignof(T)];
+                overflow.push_back(extra);
+                overflow_size += size + alignof(T);
+                uintptr_t address = reinterpret_cast<uintptr_t>(extra);
+                address = (address + alignof(T) - 1) & ~(uintptr_t) (alignof(T) - 1);
+                return reinterpret_cast<T *>(address);
+            }
+
+            void reset() {
+                if (!overflow.empty()) {
+                    size_t high_water = capacity + overflow_size;
+                    release_overflow();
+                    delete[] block;
+                    block = new unsigned char[high_water];
+                    capacity = high_water;
+                }
+                offset = 0;
+            }
+
+            size_t get_capacity() const {
+                return capacity;
+            }
+
+            size_t get_used() const {
+                return offset + overflow_size;
+            }
+    };
+}
+
+#endif // _ALINE_ARENA_H_
@@ -0,0 +1,57 @@
+#ifndef _ALINE_CONCURRENT_QUEUE_H_
+#define _ALINE_CONCURRENT_QUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace aline {
+
+    // first in first out queue shared by producer and consumer threads;
+    // try_pop never blocks, for a loop that must go on whatever arrives
+    template <class T>
+    class ConcurrentQueue {
+        private:
+            std::deque<T> items;
+            mutable std::mutex mutex;
+            std::condition_variable ready;
+        public:
+            void push( T item ) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    items.push_back(std::move(item));
+                }
+                ready.notify_one();
+            }
+
+            bool try_pop( T & item ) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (items.empty())
+                    return false;
+                item = std::move(items.front());
+                items.pop_front();
+                return true;
+            }
+
+            // waits for an item
+            T pop() {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this]() { return !items.empty(); });
+                T item = std::move(items.front());
+                items.pop_front();
+                return item;
+            }
+
+            size_t size() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return items.size();
+            }
+
+            bool empty() const {
+                return size() == 0;
+            }
+    };
+}
+
+#endif // _ALINE_CONCURRENT_QUEUE_H_
@@ -0,0 +1,181 @@
+#ifndef _ALINE_FRAMEBUFFER_H_
+#define _ALINE_FRAMEBUFFER_H_
+
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include "color.h"
+#include "vector.h"
+
+namespace aline {
+
+    // contiguous row-major color buffer the rasterizer writes into,
+    // handed to the render target once per frame
+    class ColorBuffer {
+        protected:
+            int width;
+            int height;
+            minwin::Color clear_color;
+            std::vector<minwin::Color> pixels;
+
+        public:
+            ColorBuffer( int width = 0, int height = 0 ) {
+                this->width = 0;
+                this->height = 0;
+                clear_color = minwin::BLACK;
+                resize(width, height);
+            }
+
+            void resize( int width, int height ) {
+                this->width = width;
+                this->height = height;
+                pixels.assign((size_t) width * height, clear_color);
+            }
+
+            int get_width() const {
+                return width;
+            }
+
+            int get_height() const {
+                return height;
+            }
+
+            bool contains( int x, int y ) const {
+                return x >= 0 && y >= 0 && x < width && y < height;
+            }
+
+            void clear( const minwin::Color & color = minwin::BLACK ) {
+                clear_color = color;
+                std::fill(pixels.begin(), pixels.end(), color);
+            }
+
+            void put_pixel( int x, int y, const minwin::Color & color ) {
+                if (!contains(x, y))
+                    return;
+                pixels[(size_t) y * width + x] = color;
+            }
+
+            // fills [x0, x1] on row y, clamped to the buffer
+            void fill_span( int y, int x0, int x1, const minwin::Color & color ) {
+                if (y < 0 || y >= height)
+                    return;
+                x0 = std::max(x0, 0);
+                x1 = std::min(x1, width - 1);
+                if (x0 > x1)
+                    return;
+                minwin::Color * row = &pixels[(size_t) y * width];
+                std::fill(row + x0, row + x1 + 1, color);
+            }
+
+            minwin::Color get_pixel( int x, int y ) const {
+                return pixels.at((size_t) y * width + x);
+            }
+
+            minwin::Color * data() {
+                return pixels.data();
+            }
+
+            const minwin::Color * data() const {
+                return pixels.data();
+            }
+
+            minwin::Color get_clear_color() const {
+                return clear_color;
+            }
+
+            static bool same_color( const minwin::Color & c0, const minwin::Color & c1 ) {
+                return c0.r == c1.r && c0.g == c1.g && c0.b == c1.b && c0.a == c1.a;
+            }
+
+            // binary PPM (P6) dump of the color buffer
+            void write_ppm( const std::string & file_name ) const {
+                std::ofstream out(file_name, std::ios::binary);
+                if (!out.is_open())
+                    throw std::invalid_argument("can't open PPM file");
+                out << "P6\n" << width << " " << height << "\n255\n";
+                std::vector<unsigned char> row((size_t) width * 3);
+                for (int y = 0; y < height; y++) {
+                    const minwin::Color * p = &pixels[(size_t) y * width];
+                    for (int x = 0; x < width; x++) {
+                        row[3 * x] = p[x].r;
+                        row[3 * x + 1] = p[x].g;
+                        row[3 * x + 2] = p[x].b;
+                    }
+                    out.write((const char *) row.data(), row.size());
+                }
+            }
+    };
+
+    // color buffer with a depth buffer alongside it holding 1/z (0 is
+    // infinitely far away) in the scalar type S of the render pipeline
+    template <class S>
+    class BasicFramebuffer : public ColorBuffer {
+        private:
+            std::vector<S> depth;
+
+        public:
+            BasicFramebuffer( int width = 0, int height = 0 ) {
+                resize(width, height);
+            }
+
+            void resize( int width, int height ) {
+                ColorBuffer::resize(width, height);
+                depth.assign((size_t) width * height, 0);
+            }
+
+            void clear( const minwin::Color & color = minwin::BLACK ) {
+                ColorBuffer::clear(color);
+                std::fill(depth.begin(), depth.end(), 0);
+            }
+
+            using ColorBuffer::fill_span;
+
+            // depth tested span: 1/z goes linearly from z0 at x0 to z1 at x1
+            // and a pixel is only written when it is closer than the stored one
+            void fill_span( int y, int x0, int x1, S z0, S z1, const minwin::Color & color ) {
+                if (y < 0 || y >= height)
+                    return;
+                S dz = x1 != x0 ? (z1 - z0) / (x1 - x0) : 0;
+                int xs = std::max(x0, 0);
+                int xe = std::min(x1, width - 1);
+                S z = z0 + (xs - x0) * dz;
+                minwin::Color * row = &pixels[(size_t) y * width];
+                S * depth_row = &depth[(size_t) y * width];
+                // select rather than branch so the loop vectorizes,
+                // a rejected pixel keeps its stored color and depth
+                for (int x = xs; x <= xe; x++, z += dz) {
+                    bool closer = z > depth_row[x];
+                    depth_row[x] = closer ? z : depth_row[x];
+                    row[x] = closer ? color : row[x];
+                }
+            }
+
+            // copies color and depth of src with its top left corner at (x, y)
+            void copy_from( const BasicFramebuffer & src, int x, int y ) {
+                int x0 = std::max(x, 0);
+                int x1 = std::min(x + src.width, width);
+                for (int sy = std::max(0, -y); sy < src.height && sy + y < height; sy++) {
+                    if (x0 >= x1)
+                        break;
+                    size_t from = (size_t) sy * src.width + (x0 - x);
+                    size_t to = (size_t) (sy + y) * width + x0;
+                    std::copy(src.pixels.begin() + from, src.pixels.begin() + from + (x1 - x0), pixels.begin() + to);
+                    std::copy(src.depth.begin() + from, src.depth.begin() + from + (x1 - x0), depth.begin() + to);
+                }
+            }
+
+            S get_depth( int x, int y ) const {
+                return depth.at((size_t) y * width + x);
+            }
+
+            S * depth_data() {
+                return depth.data();
+            }
+    };
+
+    using Framebuffer = BasicFramebuffer<float>;
+}
+
+#endif // _ALINE_FRAMEBUFFER_H_
@@ -0,0 +1,208 @@
+#ifndef _ALINE_HALFSPACE_H_
+#define _ALINE_HALFSPACE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "vector.h"
+#include "framebuffer.h"
+
+namespace aline {
+
+    // half-space (edge function) rasterizer: the bounding box is walked in
+    // 8x8 blocks, whole blocks are accepted or rejected from their corners
+    // and partially covered blocks are evaluated one 8 pixel row at a time
+    namespace halfspace {
+
+        const int BLOCK_SIZE = 8;
+
+        // edge functions are evaluated in 32-bit lanes, which is exact as long
+        // as the vertices stay within this many pixels of the origin
+        const int GUARD_BAND = 1 << 14;
+
+        // E(x, y) = a * x + b * y + c, positive on the inner side of the edge
+        struct Edge {
+            int a;
+            int b;
+            int c;
+
+            Edge() : a(0), b(0), c(0) {}
+
+            // top-left fill rule: pixels exactly on an edge that is neither a
+            // top nor a left edge belong to the neighbouring triangle
+            Edge( const Vec2i & p, const Vec2i & q ) {
+                a = p[1] - q[1];
+                b = q[0] - p[0];
+                c = p[0] * q[1] - p[1] * q[0];
+                if (!(a > 0 || (a == 0 && b > 0)))
+                    c -= 1;
+            }
+
+            int at( int x, int y ) const {
+                return a * x + b * y + c;
+            }
+        };
+
+        // bit i is set when pixel x + i of the row is inside all three edges,
+        // e[k] being edge k evaluated at x
+        inline uint32_t row_coverage( const int e[3], const Edge edges[3] ) {
+#if defined(__AVX2__)
+            const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i outside = _mm256_setzero_si256();
+            for (int k = 0; k < 3; k++) {
+                __m256i ek = _mm256_add_epi32(_mm256_set1_epi32(e[k]), _mm256_mullo_epi32(_mm256_set1_epi32(edges[k].a), lanes));
+                outside = _mm256_or_si256(outside, ek);
+            }
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+#elif defined(__SSE2__)
+            // no 32-bit mullo before SSE4.1, so the lane steps are built by additions
+            __m128i outside_lo = _mm_setzero_si128();
+            __m128i outside_hi = _mm_setzero_si128();
+            for (int k = 0; k < 3; k++) {
+                int a = edges[k].a;
+                __m128i ek = _mm_setr_epi32(e[k], e[k] + a, e[k] + 2 * a, e[k] + 3 * a);
+                outside_lo = _mm_or_si128(outside_lo, ek);
+                outside_hi = _mm_or_si128(outside_hi, _mm_add_epi32(ek, _mm_set1_epi32(4 * a)));
+            }
+            uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(outside_lo))
+                          | (_mm_movemask_ps(_mm_castsi128_ps(outside_hi)) << 4);
+            return ~mask & 0xFF;
+#else
+            uint32_t mask = 0;
+            for (int i = 0; i < BLOCK_SIZE; i++) {
+                int inside = (e[0] + i * edges[0].a) | (e[1] + i * edges[1].a) | (e[2] + i * edges[2].a);
+                if (inside >= 0)
+                    mask |= 1u << i;
+            }
+            return mask;
+#endif
+        }
+
+        inline int count_trailing_zeros( uint32_t mask ) {
+#if defined(__GNUC__)
+            return __builtin_ctz(mask);
+#else
+            int n = 0;
+            while (!(mask & 1)) {
+                mask >>= 1;
+                n++;
+            }
+            return n;
+#endif
+        }
+
+        // depth tested writes of the pixels of mask, z being 1/z at x; the
+        // fixed 8 lane select loop is left to the compiler to vectorize
+        template <class S>
+        inline void write_row( minwin::Color * row, S * depth_row, int x, uint32_t mask,
+                               S z, S dzdx, const minwin::Color & color ) {
+            if (mask == 0xFF) {
+                row += x;
+                depth_row += x;
+                for (int i = 0; i < BLOCK_SIZE; i++) {
+                    S zi = z + i * dzdx;
+                    bool closer = zi > depth_row[i];
+                    depth_row[i] = closer ? zi : depth_row[i];
+                    row[i] = closer ? color : row[i];
+                }
+                return;
+            }
+            while (mask) {
+                int i = count_trailing_zeros(mask);
+                mask &= mask - 1;
+                S zi = z + i * dzdx;
+                if (zi > depth_row[x + i]) {
+                    depth_row[x + i] = zi;
+                    row[x + i] = color;
+                }
+            }
+        }
+
+        // p0, p1, p2 are window coordinates and z0, z1, z2 their 1/z; returns
+        // false without drawing when a vertex lies outside the guard band;
+        // the depths are in the scalar type of the framebuffer
+        template <class S>
+        inline bool fill_triangle( BasicFramebuffer<S> & fb, Vec2i p0, std::type_identity_t<S> z0, Vec2i p1, std::type_identity_t<S> z1,
+                                   Vec2i p2, std::type_identity_t<S> z2, const minwin::Color & color ) {
+            const Vec2i * p[3] = { &p0, &p1, &p2 };
+            for (int k = 0; k < 3; k++)
+                if (std::abs((*p[k])[0]) >= GUARD_BAND || std::abs((*p[k])[1]) >= GUARD_BAND)
+                    return false;
+
+            // make the triangle counter-clockwise in edge function terms
+            long long area = (long long) (p1[0] - p0[0]) * (p2[1] - p0[1]) - (long long) (p1[1] - p0[1]) * (p2[0] - p0[0]);
+            if (area == 0)
+                return true;
+            if (area < 0) {
+                std::swap(p1, p2);
+                std::swap(z1, z2);
+                area = -area;
+            }
+
+            int xmin = std::max(std::min({p0[0], p1[0], p2[0]}), 0);
+            int ymin = std::max(std::min({p0[1], p1[1], p2[1]}), 0);
+            int xmax = std::min(std::max({p0[0], p1[0], p2[0]}), fb.get_width() - 1);
+            int ymax = std::min(std::max({p0[1], p1[1], p2[1]}), fb.get_height() - 1);
+            if (xmin > xmax || ymin > ymax)
+                return true;
+
+            // edge k is opposite to vertex k
+            Edge edges[3] = { Edge(p1, p2), Edge(p2, p0), Edge(p0, p1) };
+
+            // 1/z as a plane over the screen: z(x, y) = dzdx * x + dzdy * y + zc
+            S inv_area = S(1) / area;
+            S dzdx = (edges[0].a * z0 + edges[1].a * z1 + edges[2].a * z2) * inv_area;
+            S dzdy = (edges[0].b * z0 + edges[1].b * z1 + edges[2].b * z2) * inv_area;
+            S zc = z0 - dzdx * p0[0] - dzdy * p0[1];
+
+            const int width = fb.get_width();
+            minwin::Color * pixels = fb.data();
+            S * depth = fb.depth_data();
+            const int step = BLOCK_SIZE - 1;
+
+            for (int by = ymin & ~step; by <= ymax; by += BLOCK_SIZE) {
+                int y0 = std::max(by, ymin);
+                int y1 = std::min(by + step, ymax);
+                for (int bx = xmin & ~step; bx <= xmax; bx += BLOCK_SIZE) {
+                    // lanes of the block that are inside the bounding box
+                    uint32_t columns = 0xFF;
+                    if (bx < xmin)
+                        columns &= 0xFFu << (xmin - bx);
+                    if (bx + step > xmax)
+                        columns &= 0xFFu >> (bx + step - xmax);
+
+                    bool reject = false;
+                    bool accept = true;
+                    int e[3];
+                    for (int k = 0; k < 3; k++) {
+                        e[k] = edges[k].at(bx, by);
+                        int emax = e[k] + std::max(0, step * edges[k].a) + std::max(0, step * edges[k].b);
+                        int emin = e[k] + std::min(0, step * edges[k].a) + std::min(0, step * edges[k].b);
+                        reject = reject || emax < 0;
+                        accept = accept && emin >= 0;
+                    }
+                    if (reject)
+                        continue;
+
+                    for (int y = y0; y <= y1; y++) {
+                        int row_e[3];
+                        for (int k = 0; k < 3; k++)
+                            row_e[k] = e[k] + (y - by) * edges[k].b;
+                        uint32_t mask = accept ? columns : row_coverage(row_e, edges) & columns;
+                        if (!mask)
+                            continue;
+                        size_t offset = (size_t) y * width;
+                        write_row(pixels + offset, depth + offset, bx, mask, dzdx * bx + dzdy * y + zc, dzdx, color);
+                    }
+                }
+            }
+            return true;
+        }
+    }
+}
+
+#endif // _ALINE_HALFSPACE_H_
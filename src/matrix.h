@@ -1,143 +1,220 @@
+#ifndef _ALINE_MATRIX_H_
+#define _ALINE_MATRIX_H_
+
 
 #include <iostream>
 #include <float.h>
 #include <string>
 #include <cmath>
 #include <sstream>
+#include <utility>
+#include <limits>
+#include <type_traits>
 #include "vector.h"
 
 namespace aline {
+    // expressions over matrices, see the note on expressions in vector.h;
+    // elements are read with m(i, j)
+    template <class E, class T, int M, int N>
+    class MatrixExpr {
+        public:
+            constexpr const E & self() const {
+                return static_cast<const E &>(*this);
+            }
+    };
+
+    template <class E1, class E2, class Op, class T, int M, int N>
+    class MatrixBinaryExpr : public MatrixExpr<MatrixBinaryExpr<E1, E2, Op, T, M, N>, T, M, N> {
+        private:
+            typename expr_operand<E1>::type m;
+            typename expr_operand<E2>::type n;
+        public:
+            constexpr MatrixBinaryExpr(const E1& m, const E2& n) : m(m), n(n) {}
+
+            constexpr T operator()(size_t i, size_t j) const {
+                return Op::apply(m(i, j), n(i, j));
+            }
+    };
+
+    template <class E, class T, int M, int N>
+    class MatrixNegateExpr : public MatrixExpr<MatrixNegateExpr<E, T, M, N>, T, M, N> {
+        private:
+            typename expr_operand<E>::type m;
+        public:
+            constexpr MatrixNegateExpr(const E& m) : m(m) {}
+
+            constexpr T operator()(size_t i, size_t j) const {
+                return -m(i, j);
+            }
+    };
+
+    template <class E, class T, int M, int N>
+    class MatrixTransposeExpr : public MatrixExpr<MatrixTransposeExpr<E, T, M, N>, T, N, M> {
+        private:
+            typename expr_operand<E>::type m;
+        public:
+            constexpr MatrixTransposeExpr(const E& m) : m(m) {}
+
+            constexpr T operator()(size_t i, size_t j) const {
+                return m(j, i);
+            }
+    };
+
+    // every element of a product reads a whole row and a whole column, so
+    // operands that are themselves expressions are evaluated once into a
+    // Matrix instead of once per element
+    template <class E, class T, int M, int N>
+    struct product_operand {
+        using type = const Matrix<T, M, N>;
+    };
+
+    template <class T, int M, int N>
+    struct product_operand<Matrix<T, M, N>, T, M, N> {
+        using type = const Matrix<T, M, N> &;
+    };
+
+    template <class E1, class E2, class T, int M, int N, int O>
+    class MatrixProductExpr : public MatrixExpr<MatrixProductExpr<E1, E2, T, M, N, O>, T, M, O> {
+        private:
+            typename product_operand<E1, T, M, N>::type m;
+            typename product_operand<E2, T, N, O>::type n;
+        public:
+            constexpr MatrixProductExpr(const E1& m, const E2& n) : m(m), n(n) {}
+
+            constexpr T operator()(size_t i, size_t j) const {
+                T sum = 0;
+                for (int k = 0; k < N; k++) {
+                    sum += m(i, k) * n(k, j);
+                }
+                return sum;
+            }
+    };
+
+    // whether element (i, j) of an expression only reads elements (i, j) of
+    // its operands, in which case it can be assigned to one of them in place
+    template <class E>
+    struct matrix_elementwise {
+        static const bool value = true;
+    };
+
+    template <class E1, class E2, class Op, class T, int M, int N>
+    struct matrix_elementwise<MatrixBinaryExpr<E1, E2, Op, T, M, N>> {
+        static const bool value = matrix_elementwise<E1>::value && matrix_elementwise<E2>::value;
+    };
+
+    template <class E, class T, int M, int N>
+    struct matrix_elementwise<MatrixNegateExpr<E, T, M, N>> {
+        static const bool value = matrix_elementwise<E>::value;
+    };
+
+    template <class E, class T, int M, int N>
+    struct matrix_elementwise<MatrixTransposeExpr<E, T, M, N>> {
+        static const bool value = false;
+    };
+
+    template <class E1, class E2, class T, int M, int N, int O>
+    struct matrix_elementwise<MatrixProductExpr<E1, E2, T, M, N, O>> {
+        static const bool value = false;
+    };
+
     template <class T, int M,int N>
-    class Matrix {
+    class Matrix : public MatrixExpr<Matrix<T, M, N>, T, M, N> {
     private:
         Vector<T, N> matrix[M];
+
+        template <class E>
+        constexpr void assign(const E& e) {
+            for (int i = 0; i < M; i++) {
+                T * row = matrix[i].data();
+                for (int j = 0; j < N; j++) {
+                    row[j] = e(i, j);
+                }
+            }
+        }
     public:
-        Matrix() {
+        constexpr Matrix() {
             for (int i = 0; i < M; i++) {
                 matrix[i] = Vector<T, N>();
             }
         }
 
-        Matrix(std::initializer_list<Vector<T, N>> list) {
+        constexpr Matrix(std::initializer_list<Vector<T, N>> list) {
             if (list.size() > (size_t) M)
                 throw std::runtime_error("list size bigger than M");
-            Vector<T,N> l[list.size()];
-            int s = 0;
-            for (auto& i : list) {
-                l[s++] = Vector<T, N>(i);
+            int i = 0;
+            for (const Vector<T, N>& row : list) {
+                matrix[i++] = row;
             }
-            for (int i = 0; i < M; i++) {
-                if ((size_t) i >= list.size())
-                    matrix[i] = Vector<T, N>();
-                else
-                    matrix[i] = Vector<T, N>(l[i]);
+            for (; i < M; i++) {
+                matrix[i] = Vector<T, N>();
             }
         }
 
-        Matrix(const Matrix<T, M, N>&m) {
-            for (int i = 0; i < N; i++) {
-                matrix[i] = m[i];
-            }
+        template <class E>
+        constexpr Matrix(const MatrixExpr<E, T, M, N>& e) {
+            assign(e.self());
         }
 
-        Vector<T, N> at(size_t i) {
+        template <class E>
+        constexpr Matrix<T, M, N>& operator=(const MatrixExpr<E, T, M, N>& e) {
+            if constexpr (matrix_elementwise<E>::value)
+                assign(e.self());
+            else
+                *this = Matrix<T, M, N>(e);
+            return *this;
+        }
+
+        constexpr Vector<T, N> at(size_t i) const {
             if (i >= M)
                 throw std::runtime_error("index out of range");
             return matrix[i];
         }
 
-        T at(size_t i, size_t j) {
+        constexpr T at(size_t i, size_t j) const {
             if (i >= M || j >=N)
                 throw std::runtime_error("index out of range");
             return matrix[i][j];
         }
 
-        Vector<T, N> operator[](size_t i) const {
+        constexpr const Vector<T, N>& operator[](size_t i) const {
+#if ALINE_BOUNDS_CHECK
+            if (i >= M)
+                throw std::runtime_error("index out of range");
+#endif
             return matrix[i];
         }
 
-        Vector<T, N>& operator[](size_t i) {
+        constexpr Vector<T, N>& operator[](size_t i) {
+#if ALINE_BOUNDS_CHECK
+            if (i >= M)
+                throw std::runtime_error("index out of range");
+#endif
             return matrix[i];
         }
 
-        Matrix<T, M, N>& operator+=(const Matrix<T, M, N>&m) {
-            for (int i = 0; i < M; i++) {
-                matrix[i] += m[i];
-            }
-            return *this;
-        }
-    };
-
-    template <class T, int N> int det(const Matrix<T, N, N>& m, int n) {
-        int d = 0;
-        if (n == 1)
-            return m[0][0];
-        Matrix<T, N, N> res;
-        int s = 1;
-        for (int f = 0; f < n; f++) {
-            res = getCfactor(m, 0, f, n);
-            d += s * m[0][f] * det(res, n - 1);
-            s = -s;
-        }
-        return d;
-    }
-
-    template <class T, int N> Matrix<T, N, N> getCfactor(const Matrix<T, N, N>&m, int p, int q, int n) {
-        int i = 0, j = 0;
-        Matrix<T, N, N> res;
-        for (int r= 0; r< n; r++) {
-            for (int c = 0; c< n; c++)
-                if (r != p && c != q) { res[i][j++] = m[r][c];
-                    if (j == n - 1) {
-                        j = 0; i++;
-                    }
-                }
+        constexpr T operator()(size_t i, size_t j) const {
+            return matrix[i].data()[j];
         }
-        return res;
-    }
 
-    template <class T, int N> Matrix<double, N, N> adj(const Matrix<T, N, N>&m) {
-        Matrix<T, N, N> res;
-        Matrix<double, N, N> adj;
-        if (N == 1) {
-            adj[0][0] = 1; 
-            return adj;
+        // the elements of row 0; the rows are contiguous, but a pointer into
+        // one row may not be moved into the next, so other rows go through
+        // operator[]
+        constexpr T * data() {
+            return matrix[0].data();
         }
-        int s = 1;
-        for (int i=0; i<N; i++) {
-            for (int j=0; j<N; j++) {
-                res = getCfactor(m, i, j, N);
-                s = ((i+j)%2==0)? 1: -1; //sign of adj[j][i] positive if sum of row and column indexes is even.
-                adj[j][i] = (s)*(det(res, N-1)); //Interchange rows and columns to get the transpose of the cofactor matrix
-            }
-        }
-        return adj;
-    }
 
-    template <class T, int M, int N> Matrix<double, M, N> inverse(const Matrix<T, M, N>&m) {
-        Matrix<double, N, N> res;
-        if (M != N) {
-            for (int i = 0; i < M; i++)
-                for (int j = 0; j < N; j++)
-                    res[i][j] = nan("");
-            return res;
+        constexpr const T * data() const {
+            return matrix[0].data();
         }
 
-        int determinant = det(m, N);
-
-        if (determinant == 0) {
-           for (int i = 0; i < M; i++)
-               for (int j = 0; j < N; j++)
-                   res[i][j] = nan("");
-           return res;
+        template <class E>
+        constexpr Matrix<T, M, N>& operator+=(const MatrixExpr<E, T, M, N>& e) {
+            return *this = *this + e;
         }
+    };
 
-        res = adj(m) / (double) determinant;
-
-        return res;
-    }
-
-    template <class T, int M, int N> bool isnan(const Matrix<T, M, N>&m) {
+    template <class T, int M, int N, class E> bool isnan(const MatrixExpr<E, T, M, N>& e) {
+        const Matrix<T, M, N> m = e.self();
         for (int i = 0; i < M; i++) {
             if (isnan(m[i]))
                 return true;
@@ -145,7 +222,9 @@ namespace aline {
         return false;
     }
 
-    template <class T, int M, int N> bool nearly_equal(const Matrix<T, M, N>& m, const Matrix<T, M, N>& n) {
+    template <class T, int M, int N, class E1, class E2> bool nearly_equal(const MatrixExpr<E1, T, M, N>& a, const MatrixExpr<E2, T, M, N>& b) {
+        const Matrix<T, M, N> m = a.self();
+        const Matrix<T, M, N> n = b.self();
         for (int i = 0; i < M; i++) {
             if (!nearly_equal(m[i], n[i]))
                 return false;
@@ -153,15 +232,21 @@ namespace aline {
         return true;
     }
 
-    template <class T, int M, int N> bool operator==(const Matrix<T, M, N>&m, const Matrix<T, M, N>&n) {
+    template <class T, int M, int N, class E1, class E2> constexpr bool operator==(const MatrixExpr<E1, T, M, N>& a, const MatrixExpr<E2, T, M, N>& b) {
+        const E1 & m = a.self();
+        const E2 & n = b.self();
         for (int i = 0; i < M; i++) {
-            if (m[i] != n[i])
-                return false;
+            for (int j = 0; j < N; j++) {
+                if (m(i, j) != n(i, j))
+                    return false;
+            }
         }
         return true;
     }
 
-    template <class T, int M, int N> bool operator!=(const Matrix<T, M, N>& m, const Matrix<T, M, N>& n) {
+    template <class T, int M, int N, class E1, class E2> constexpr bool operator!=(const MatrixExpr<E1, T, M, N>& a, const MatrixExpr<E2, T, M, N>& b) {
+        const Matrix<T, M, N> m = a.self();
+        const Matrix<T, M, N> n = b.self();
         for (int i = 0; i < M; i++) {
             if (m[i] == n[i])
                 return false;
@@ -169,86 +254,62 @@ namespace aline {
         return true;
     }
 
-    template <class T, int M, int N> std::ostream& operator<<(std::ostream& out, const Matrix<T, M, N>&m) {
+    template <class T, int M, int N, class E> std::ostream& operator<<(std::ostream& out, const MatrixExpr<E, T, M, N>& m) {
         out << to_string(m) << std::endl;
         return out;
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator+(const Matrix<T, M, N>&m, const Matrix<T, M, N>&n) {
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = m[i] + n[i];
-        }
-        return res;
+    template <class T, int M, int N, class E1, class E2>
+    constexpr MatrixBinaryExpr<E1, E2, ExprAdd, T, M, N> operator+(const MatrixExpr<E1, T, M, N>& m, const MatrixExpr<E2, T, M, N>& n) {
+        return MatrixBinaryExpr<E1, E2, ExprAdd, T, M, N>(m.self(), n.self());
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator-(const Matrix<T, M, N>&m) {
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = -m[i];
-        }
-        return res;
+    template <class T, int M, int N, class E> constexpr MatrixNegateExpr<E, T, M, N> operator-(const MatrixExpr<E, T, M, N>& m) {
+        return MatrixNegateExpr<E, T, M, N>(m.self());
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator-(const Matrix<T, M, N>&m, const Matrix<T, M, N>&n) {
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = m[i] - n[i];
-        }
-        return res;
+    template <class T, int M, int N, class E1, class E2>
+    constexpr MatrixBinaryExpr<E1, E2, ExprSub, T, M, N> operator-(const MatrixExpr<E1, T, M, N>& m, const MatrixExpr<E2, T, M, N>& n) {
+        return MatrixBinaryExpr<E1, E2, ExprSub, T, M, N>(m.self(), n.self());
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator*(const T& t, const Matrix<T, M, N>& m) {
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = t * m[i];
-        }
-        return res;
+    template <class T, int M, int N, class E>
+    constexpr MatrixBinaryExpr<ExprScalar<T>, E, ExprMul, T, M, N> operator*(const T& t, const MatrixExpr<E, T, M, N>& m) {
+        return MatrixBinaryExpr<ExprScalar<T>, E, ExprMul, T, M, N>(ExprScalar<T>(t), m.self());
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator*(const Matrix<T, M, N>& m, const T& t) {
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = Vector<T, N>(m[i] * t);
-        }
-        return res;
+    template <class T, int M, int N, class E>
+    constexpr MatrixBinaryExpr<E, ExprScalar<T>, ExprMul, T, M, N> operator*(const MatrixExpr<E, T, M, N>& m, const T& t) {
+        return MatrixBinaryExpr<E, ExprScalar<T>, ExprMul, T, M, N>(m.self(), ExprScalar<T>(t));
     }
 
-    template <class T, int M, int N>
-    Vector<T, M> operator*(const Matrix<T, M, N>& m, const Vector<T, N>& v) {
+    // the vector is evaluated once, the result is a Vector
+    template <class T, int M, int N, class E1, class E2>
+    constexpr Vector<T, M> operator*(const MatrixExpr<E1, T, M, N>& e, const VectorExpr<E2, T, N>& x) {
+        const E1 & m = e.self();
+        const Vector<T, N> v = x.self();
         Vector<T, M> res;
         for (int i = 0; i < M; i++)
             for (int j = 0; j < N; j++)
-                res[i] += (m[i][j] * v[j]);
+                res[i] += (m(i, j) * v[j]);
         return res;
     }
 
-
-    template <class T, int M, int N, int O> Matrix<T, M, O> operator*(const Matrix<T, M, N>& m, const Matrix<T, N, O>& n) {
-        Matrix<T, M, O> res  = Matrix<T, M, O>();
-        for (int i = 0; i < M; i++) {
-            for (int j = 0; j < O; j++) {
-                T sum = 0;
-                for (int k = 0; k < N; k++) {
-                    sum += m[i][k] * n[k][j];
-                }
-                res[i][j] = sum;
-            }
-        }
-        return res;
+    template <class T, int M, int N, int O, class E1, class E2>
+    constexpr MatrixProductExpr<E1, E2, T, M, N, O> operator*(const MatrixExpr<E1, T, M, N>& m, const MatrixExpr<E2, T, N, O>& n) {
+        return MatrixProductExpr<E1, E2, T, M, N, O>(m.self(), n.self());
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> operator/(const Matrix<T, M, N>& m, const T& s) {
+    // multiplies by the reciprocal, computed once
+    template <class T, int M, int N, class E>
+    constexpr MatrixBinaryExpr<ExprScalar<T>, E, ExprMul, T, M, N> operator/(const MatrixExpr<E, T, M, N>& m, const T& s) {
         if (s == 0)
             throw std::runtime_error("div by zero");
-        Matrix<T, M, N> res;
-        for (int i = 0; i < M; i++) {
-            res[i] = 1 / s * m[i];
-        }
-        return res;
+        return MatrixBinaryExpr<ExprScalar<T>, E, ExprMul, T, M, N>(ExprScalar<T>(1 / s), m.self());
     }
 
-    template <class T, int M, int N> std::string to_string(const Matrix<T, M, N>& m) {
+    template <class T, int M, int N, class E> std::string to_string(const MatrixExpr<E, T, M, N>& e) {
+        const Matrix<T, M, N> m = e.self();
         std::stringstream s;
         s << "(";
         for (int i = 0; i < M; i++) {
@@ -258,15 +319,218 @@ namespace aline {
         return s.str();
     }
 
-    template <class T, int M, int N> Matrix<T, M, N> transpose(const Matrix<T, M, N>&m) {
-        Matrix<T, M, N> res;
+    template <class T, int M, int N, class E> constexpr MatrixTransposeExpr<E, T, M, N> transpose(const MatrixExpr<E, T, M, N>& m) {
+        return MatrixTransposeExpr<E, T, M, N>(m.self());
+    }
+
+    template <class T> constexpr T abs_value(T x) {
+        return x < 0 ? -x : x;
+    }
+
+    // determinant by LU decomposition with partial pivoting
+    template <class T, int N> constexpr double det(const Matrix<T, N, N>& m) {
+        double a[N][N];
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
+                a[i][j] = m[i][j];
+        double d = 1;
+        for (int c = 0; c < N; c++) {
+            int p = c;
+            for (int r = c + 1; r < N; r++)
+                if (abs_value(a[r][c]) > abs_value(a[p][c]))
+                    p = r;
+            if (a[p][c] == 0)
+                return 0;
+            if (p != c) {
+                std::swap(a[p], a[c]);
+                d = -d;
+            }
+            d *= a[c][c];
+            for (int r = c + 1; r < N; r++) {
+                double f = a[r][c] / a[c][c];
+                for (int k = c + 1; k < N; k++)
+                    a[r][k] -= f * a[c][k];
+            }
+        }
+        return d;
+    }
+
+    template <class T> constexpr double det(const Matrix<T, 2, 2>& m) {
+        return (double) m[0][0] * m[1][1] - (double) m[0][1] * m[1][0];
+    }
+
+    template <class T> constexpr double det(const Matrix<T, 3, 3>& m) {
+        return m[0][0] * ((double) m[1][1] * m[2][2] - (double) m[1][2] * m[2][1])
+             - m[0][1] * ((double) m[1][0] * m[2][2] - (double) m[1][2] * m[2][0])
+             + m[0][2] * ((double) m[1][0] * m[2][1] - (double) m[1][1] * m[2][0]);
+    }
+
+    template <class T, int M, int N> constexpr Matrix<double, M, N> nan_matrix() {
+        Matrix<double, M, N> res;
+        for (int i = 0; i < M; i++)
+            for (int j = 0; j < N; j++)
+                res[i][j] = std::numeric_limits<double>::quiet_NaN();
+        return res;
+    }
+
+    // Gauss-Jordan elimination with partial pivoting, a matrix of NaN when m
+    // is not square or is singular
+    template <class T, int M, int N> constexpr Matrix<double, M, N> inverse(const Matrix<T, M, N>&m) {
+        if (M != N)
+            return nan_matrix<T, M, N>();
+
+        double a[M][N];
+        Matrix<double, M, N> res;
         for (int i = 0; i < M; i++) {
-            for (int j = 0; j < N; j++) {
-                res[j][i] = m[i][j];
+            for (int j = 0; j < N; j++)
+                a[i][j] = m[i][j];
+            res[i][i] = 1;
+        }
+        for (int c = 0; c < N; c++) {
+            int p = c;
+            for (int r = c + 1; r < M; r++)
+                if (abs_value(a[r][c]) > abs_value(a[p][c]))
+                    p = r;
+            if (a[p][c] == 0)
+                return nan_matrix<T, M, N>();
+            if (p != c) {
+                std::swap(a[p], a[c]);
+                std::swap(res[p], res[c]);
             }
+            double f = 1 / a[c][c];
+            for (int k = 0; k < N; k++)
+                a[c][k] *= f;
+            res[c] = res[c] * f;
+            for (int r = 0; r < M; r++) {
+                if (r == c || a[r][c] == 0)
+                    continue;
+                double g = a[r][c];
+                for (int k = 0; k < N; k++)
+                    a[r][k] -= g * a[c][k];
+                res[r] = res[r] - g * res[c];
+            }
+        }
+        return res;
+    }
+
+    // closed form: adjugate over determinant
+    template <class T> constexpr Matrix<double, 2, 2> inverse(const Matrix<T, 2, 2>& m) {
+        double d = det(m);
+        if (d == 0)
+            return nan_matrix<T, 2, 2>();
+        Matrix<double, 2, 2> adj { {(double) m[1][1], (double) -m[0][1]}, {(double) -m[1][0], (double) m[0][0]} };
+        return adj / d;
+    }
+
+    template <class T> constexpr Matrix<double, 3, 3> inverse(const Matrix<T, 3, 3>& m) {
+        double d = det(m);
+        if (d == 0)
+            return nan_matrix<T, 3, 3>();
+        Matrix<double, 3, 3> adj;
+        for (int i = 0; i < 3; i++) {
+            int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+            for (int j = 0; j < 3; j++) {
+                int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+                // cyclic minors carry the cofactor sign
+                adj[j][i] = (double) m[i1][j1] * m[i2][j2] - (double) m[i1][j2] * m[i2][j1];
+            }
+        }
+        return adj / d;
+    }
+
+    // inverse of a transform whose upper-left 3x3 block is a rotation and
+    // whose last row is (0, 0, 0, 1): transposed rotation, rotated back translation
+    template <class T> constexpr Matrix<T, 4, 4> rigid_inverse(const Matrix<T, 4, 4>& m) {
+        Matrix<T, 4, 4> res;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                res[i][j] = m[j][i];
+            res[i][3] = -(m[0][i] * m[0][3] + m[1][i] * m[1][3] + m[2][i] * m[2][3]);
+        }
+        res[3][3] = 1;
+        return res;
+    }
+
+    // inverse of a transform whose last row is (0, 0, 0, 1), e.g. any
+    // combination of translations, rotations and scales
+    template <class T> constexpr Matrix<T, 4, 4> affine_inverse(const Matrix<T, 4, 4>& m) {
+        Matrix<T, 3, 3> a;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                a[i][j] = m[i][j];
+        Matrix<double, 3, 3> b = inverse(a);
+        Matrix<T, 4, 4> res;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                res[i][j] = b[i][j];
+            res[i][3] = -(b[i][0] * m[0][3] + b[i][1] * m[1][3] + b[i][2] * m[2][3]);
         }
+        res[3][3] = 1;
         return res;
     }
+
+    // sine and cosine that can be evaluated at compile time, by a Taylor series
+    // after reduction to [-pi, pi]; std::sin and std::cos at run time
+    template <class T> constexpr T constexpr_sin(T x) {
+        if (!std::is_constant_evaluated())
+            return std::sin(x);
+        const T pi = 3.14159265358979323846;
+        long long turns = (long long) (x / (2 * pi) + (x < 0 ? -0.5 : 0.5));
+        x -= turns * 2 * pi;
+        T term = x;
+        T sum = x;
+        for (int k = 1; k < 30; k++) {
+            term *= -x * x / ((2 * k) * (2 * k + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    template <class T> constexpr T constexpr_cos(T x) {
+        if (!std::is_constant_evaluated())
+            return std::cos(x);
+        const T pi = 3.14159265358979323846;
+        return constexpr_sin(x + pi / 2);
+    }
+
+    template <class T, int N> constexpr Matrix<T, N, N> identity() {
+        Matrix<T, N, N> res;
+        for (int i = 0; i < N; i++)
+            res[i][i] = 1;
+        return res;
+    }
+
+    template <class T> constexpr Matrix<T, 4, 4> translation(T x, T y, T z) {
+        return Matrix<T, 4, 4> { {1, 0, 0, x}, {0, 1, 0, y}, {0, 0, 1, z}, {0, 0, 0, 1} };
+    }
+
+    template <class T> constexpr Matrix<T, 4, 4> scaling(T x, T y, T z) {
+        return Matrix<T, 4, 4> { {x, 0, 0, 0}, {0, y, 0, 0}, {0, 0, z, 0}, {0, 0, 0, 1} };
+    }
+
+    // counter-clockwise rotations by angle radians, looking down the axis
+    template <class T> constexpr Matrix<T, 4, 4> rotation_x(T angle) {
+        T c = constexpr_cos(angle);
+        T s = constexpr_sin(angle);
+        return Matrix<T, 4, 4> { {1, 0, 0, 0}, {0, c, -s, 0}, {0, s, c, 0}, {0, 0, 0, 1} };
+    }
+
+    template <class T> constexpr Matrix<T, 4, 4> rotation_y(T angle) {
+        T c = constexpr_cos(angle);
+        T s = constexpr_sin(angle);
+        return Matrix<T, 4, 4> { {c, 0, s, 0}, {0, 1, 0, 0}, {-s, 0, c, 0}, {0, 0, 0, 1} };
+    }
+
+    template <class T> constexpr Matrix<T, 4, 4> rotation_z(T angle) {
+        T c = constexpr_cos(angle);
+        T s = constexpr_sin(angle);
+        return Matrix<T, 4, 4> { {c, -s, 0, 0}, {s, c, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} };
+    }
 }
 
-using Mat44r = aline::Matrix<real,4ul,4ul>;
\ No newline at end of file
+using Mat44r = aline::Matrix<real,4ul,4ul>;
+using Mat44f = aline::Matrix<float,4ul,4ul>;
+
+#include "simd.h"
+
+#endif // _ALINE_MATRIX_H_
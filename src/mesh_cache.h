@@ -0,0 +1,331 @@
+#ifndef _ALINE_MESH_CACHE_H_
+#define _ALINE_MESH_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "shape.h"
+#include "obj_loader.h"
+
+namespace aline {
+
+    static_assert(sizeof(minwin::Color) == 4, "colors are stored as 4 bytes");
+
+    // FNV-1a over 8 byte words, the last one padded with zeros: the
+    // multiply chain runs on words instead of bytes
+    inline uint64_t fnv1a( const void * data, size_t size, uint64_t hash = 14695981039346656037ull ) {
+        const unsigned char * p = static_cast<const unsigned char *>(data);
+        const size_t words = size / 8;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t w;
+            std::memcpy(&w, p + 8 * i, 8);
+            hash = (hash ^ w) * 1099511628211ull;
+        }
+        if (size % 8 != 0) {
+            uint64_t w = 0;
+            std::memcpy(&w, p + 8 * words, size % 8);
+            hash = (hash ^ w) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // what a cache file remembers of the OBJ file it was made from
+    struct SourceStamp {
+        uint64_t size = 0;
+        int64_t mtime = 0;      // nanoseconds
+        uint64_t hash = 0;      // fnv1a of the whole text
+    };
+
+    // size and modification time of a file, without its hash
+    inline SourceStamp stat_source( const char * file_name ) {
+        struct stat st;
+        if (::stat(file_name, &st) != 0)
+            throw std::invalid_argument(std::string("can't open ") + file_name);
+        SourceStamp stamp;
+        stamp.size = st.st_size;
+#ifdef __APPLE__
+        stamp.mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        stamp.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+        return stamp;
+    }
+
+    const char MESH_MAGIC[8] = {'A', 'L', 'M', 'E', 'S', 'H', '\r', '\n'};
+    const uint32_t MESH_VERSION = 2;
+    // streams start on cache line boundaries, the mapping itself being
+    // page aligned
+    const uint64_t MESH_ALIGNMENT = 64;
+
+    // first bytes of a mesh file, followed by the x, y, z, index and color
+    // streams at the given offsets, then the normal and texture coordinate
+    // streams when normal_count and uv_count are the vertex count rather
+    // than 0; the checksum covers every byte after the header, in native
+    // byte order, and is only checked on request (see open_mesh)
+    struct MeshHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t file_size;
+        SourceStamp source;
+        uint64_t vertex_count;
+        uint64_t face_count;
+        uint64_t x_offset;
+        uint64_t y_offset;
+        uint64_t z_offset;
+        uint64_t index_offset;
+        uint64_t color_offset;
+        uint64_t normal_count;
+        uint64_t nx_offset;
+        uint64_t ny_offset;
+        uint64_t nz_offset;
+        uint64_t uv_count;
+        uint64_t u_offset;
+        uint64_t v_offset;
+        double bounds_min[3];
+        double bounds_max[3];
+        double bounds_center[3];
+        double bounds_radius;
+        uint64_t checksum;
+    };
+
+    inline uint64_t mesh_align( uint64_t offset ) {
+        return (offset + MESH_ALIGNMENT - 1) & ~(MESH_ALIGNMENT - 1);
+    }
+
+    // whether every index of the stream names one of vertex_count vertices
+    inline bool indices_in_range( View<uint> indices, uint64_t vertex_count ) {
+        uint largest = 0;
+        for (size_t i = 0; i < indices.size(); i++)
+            largest = std::max(largest, indices[i]);
+        return indices.empty() || largest < vertex_count;
+    }
+
+    // the cache of an OBJ file sits next to it
+    inline std::string mesh_cache_path( const char * obj_file ) {
+        return std::string(obj_file) + ".mesh";
+    }
+
+    // writes shape to file_name, through a temporary file renamed at the
+    // end so that a reader never maps a half written mesh
+    inline void write_mesh( const Shape & shape, const char * file_name, const SourceStamp & source ) {
+        const View<float> xs = shape.get_x();
+        const View<float> ys = shape.get_y();
+        const View<float> zs = shape.get_z();
+        const View<uint> indices = shape.get_indices();
+        const View<minwin::Color> colors = shape.get_colors();
+        const VertexAttributes & attributes = shape.get_attributes();
+        const Bounds & bounds = shape.get_bounds();
+        if (!indices_in_range(indices, xs.size()))
+            throw std::invalid_argument(std::string("index out of range in mesh ") + shape.get_name());
+
+        MeshHeader header {};
+        std::memcpy(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+        header.version = MESH_VERSION;
+        header.header_size = sizeof(MeshHeader);
+        header.source = source;
+        header.vertex_count = xs.size();
+        header.face_count = colors.size();
+        header.x_offset = mesh_align(sizeof(MeshHeader));
+        header.y_offset = mesh_align(header.x_offset + xs.size() * sizeof(float));
+        header.z_offset = mesh_align(header.y_offset + ys.size() * sizeof(float));
+        header.index_offset = mesh_align(header.z_offset + zs.size() * sizeof(float));
+        header.color_offset = mesh_align(header.index_offset + indices.size() * sizeof(uint));
+        header.normal_count = attributes.nx.size();
+        header.nx_offset = mesh_align(header.color_offset + colors.size() * sizeof(minwin::Color));
+        header.ny_offset = mesh_align(header.nx_offset + attributes.nx.size() * sizeof(float));
+        header.nz_offset = mesh_align(header.ny_offset + attributes.ny.size() * sizeof(float));
+        header.uv_count = attributes.u.size();
+        header.u_offset = mesh_align(header.nz_offset + attributes.nz.size() * sizeof(float));
+        header.v_offset = mesh_align(header.u_offset + attributes.u.size() * sizeof(float));
+        header.file_size = mesh_align(header.v_offset + attributes.v.size() * sizeof(float));
+        for (int i = 0; i < 3; i++) {
+            header.bounds_min[i] = bounds.min[i];
+            header.bounds_max[i] = bounds.max[i];
+            header.bounds_center[i] = bounds.center[i];
+        }
+        header.bounds_radius = bounds.radius;
+
+        std::vector<char> file(header.file_size, 0);
+        std::memcpy(file.data() + header.x_offset, xs.data(), xs.size() * sizeof(float));
+        std::memcpy(file.data() + header.y_offset, ys.data(), ys.size() * sizeof(float));
+        std::memcpy(file.data() + header.z_offset, zs.data(), zs.size() * sizeof(float));
+        std::memcpy(file.data() + header.index_offset, indices.data(), indices.size() * sizeof(uint));
+        std::memcpy(file.data() + header.color_offset, colors.data(), colors.size() * sizeof(minwin::Color));
+        // the attribute streams are often empty, with no data to copy from
+        auto copy_attribute = [&](uint64_t offset, View<float> stream) {
+            if (!stream.empty())
+                std::memcpy(file.data() + offset, stream.data(), stream.size() * sizeof(float));
+        };
+        copy_attribute(header.nx_offset, attributes.nx);
+        copy_attribute(header.ny_offset, attributes.ny);
+        copy_attribute(header.nz_offset, attributes.nz);
+        copy_attribute(header.u_offset, attributes.u);
+        copy_attribute(header.v_offset, attributes.v);
+        header.checksum = fnv1a(file.data() + sizeof(MeshHeader), header.file_size - sizeof(MeshHeader));
+        std::memcpy(file.data(), &header, sizeof(MeshHeader));
+
+        // several threads or processes may write the same cache at once
+        static std::atomic<unsigned> writes {0};
+        std::string temporary = std::string(file_name) + "." + std::to_string(::getpid()) + "." + std::to_string(writes++) + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            out.write(file.data(), file.size());
+            if (!out) {
+                out.close();
+                std::remove(temporary.c_str());
+                throw std::runtime_error(std::string("can't write mesh file ") + file_name);
+            }
+        }
+        if (std::rename(temporary.c_str(), file_name) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error(std::string("can't write mesh file ") + file_name);
+        }
+    }
+
+    // reads the header of a mesh file and checks that it is one this
+    // version can map; false when the file is missing or not usable
+    inline bool read_mesh_header( const char * file_name, MeshHeader & header ) {
+        int fd = ::open(file_name, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        bool ok = ::fstat(fd, &st) == 0 && ::pread(fd, &header, sizeof(header), 0) == sizeof(header);
+        ::close(fd);
+        return ok
+            && std::memcmp(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) == 0
+            && header.version == MESH_VERSION
+            && header.header_size == sizeof(MeshHeader)
+            && header.file_size == uint64_t(st.st_size);
+    }
+
+    // maps a mesh file and builds a Shape whose streams point into the
+    // mapping, which the shape and its copies keep alive. Only the header
+    // and the index stream are read here: the indices are checked against
+    // the vertex count since drawing trusts them, the other pages are
+    // faulted in when first used. verify also checks the checksum, which
+    // reads the whole file
+    inline Shape open_mesh( const char * file_name, const std::string & name, bool verify = false ) {
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(file_name);
+        if (file->size() < sizeof(MeshHeader))
+            throw std::runtime_error(std::string("not a mesh file: ") + file_name);
+        MeshHeader header;
+        std::memcpy(&header, file->begin(), sizeof(header));
+        if (std::memcmp(header.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0 || header.version != MESH_VERSION
+            || header.header_size != sizeof(MeshHeader) || header.file_size != file->size())
+            throw std::runtime_error(std::string("not a mesh file of this version: ") + file_name);
+
+        const uint64_t v = header.vertex_count;
+        const uint64_t f = header.face_count;
+        const uint64_t n = header.normal_count;
+        const uint64_t t = header.uv_count;
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset % MESH_ALIGNMENT == 0 && offset >= sizeof(MeshHeader) && offset <= header.file_size
+                && bytes <= header.file_size - offset;
+        };
+        if (v > header.file_size || f > header.file_size
+            || !fits(header.x_offset, v * sizeof(float)) || !fits(header.y_offset, v * sizeof(float))
+            || !fits(header.z_offset, v * sizeof(float)) || !fits(header.index_offset, 3 * f * sizeof(uint))
+            || !fits(header.color_offset, f * sizeof(minwin::Color))
+            || (n != 0 && n != v) || !fits(header.nx_offset, n * sizeof(float))
+            || !fits(header.ny_offset, n * sizeof(float)) || !fits(header.nz_offset, n * sizeof(float))
+            || (t != 0 && t != v) || !fits(header.u_offset, t * sizeof(float)) || !fits(header.v_offset, t * sizeof(float)))
+            throw std::runtime_error(std::string("corrupted mesh file: ") + file_name);
+        if (verify && fnv1a(file->begin() + sizeof(MeshHeader), header.file_size - sizeof(MeshHeader)) != header.checksum)
+            throw std::runtime_error(std::string("corrupted mesh file: ") + file_name);
+        const View<uint> indices(reinterpret_cast<const uint *>(file->begin() + header.index_offset), 3 * f);
+        if (!indices_in_range(indices, v))
+            throw std::runtime_error(std::string("corrupted mesh file: ") + file_name);
+
+        Bounds bounds;
+        for (int i = 0; i < 3; i++) {
+            bounds.min[i] = header.bounds_min[i];
+            bounds.max[i] = header.bounds_max[i];
+            bounds.center[i] = header.bounds_center[i];
+        }
+        bounds.radius = header.bounds_radius;
+
+        const char * base = file->begin();
+        VertexAttributes attributes;
+        attributes.nx = View<float>(reinterpret_cast<const float *>(base + header.nx_offset), n);
+        attributes.ny = View<float>(reinterpret_cast<const float *>(base + header.ny_offset), n);
+        attributes.nz = View<float>(reinterpret_cast<const float *>(base + header.nz_offset), n);
+        attributes.u = View<float>(reinterpret_cast<const float *>(base + header.u_offset), t);
+        attributes.v = View<float>(reinterpret_cast<const float *>(base + header.v_offset), t);
+        return Shape(name,
+                     View<float>(reinterpret_cast<const float *>(base + header.x_offset), v),
+                     View<float>(reinterpret_cast<const float *>(base + header.y_offset), v),
+                     View<float>(reinterpret_cast<const float *>(base + header.z_offset), v),
+                     indices,
+                     View<minwin::Color>(reinterpret_cast<const minwin::Color *>(base + header.color_offset), f),
+                     bounds, file, attributes);
+    }
+
+    // whether the cache of obj_file was made from its current content: same
+    // size and modification time, or, when only the time changed (a copy,
+    // a touch), the same hash, in which case the cache takes the new time
+    inline bool mesh_cache_valid( const char * obj_file ) {
+        const std::string cache = mesh_cache_path(obj_file);
+        MeshHeader header;
+        if (!read_mesh_header(cache.c_str(), header))
+            return false;
+        SourceStamp stamp = stat_source(obj_file);
+        if (stamp.size != header.source.size)
+            return false;
+        if (stamp.mtime == header.source.mtime)
+            return true;
+        MappedFile source(obj_file);
+        if (fnv1a(source.begin(), source.size()) != header.source.hash)
+            return false;
+        // the header is outside the checksum and can be updated in place
+        header.source.mtime = stamp.mtime;
+        int fd = ::open(cache.c_str(), O_WRONLY);
+        if (fd >= 0) {
+            if (::pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+                // not fatal, the source is hashed again next time
+            }
+            ::close(fd);
+        }
+        return true;
+    }
+
+    // parses obj_file and writes its cache, returns the parsed shape; a
+    // cache that can't be written (read-only directory...) is skipped
+    inline Shape build_mesh_cache( const char * obj_file, unsigned threads = std::thread::hardware_concurrency() ) {
+        SourceStamp stamp = stat_source(obj_file);
+        MappedFile source(obj_file);
+        Shape shape = parse_obj(obj_file, source.begin(), source.end(), threads);
+        stamp.hash = fnv1a(source.begin(), source.size());
+        try {
+            write_mesh(shape, mesh_cache_path(obj_file).c_str(), stamp);
+        } catch (const std::runtime_error &) {
+        }
+        return shape;
+    }
+
+    // the shape of obj_file, mapped from its cache when it is up to date,
+    // parsed (and cached for the next time) otherwise
+    inline Shape load_mesh( const char * obj_file, unsigned threads = std::thread::hardware_concurrency() ) {
+        if (mesh_cache_valid(obj_file)) {
+            try {
+                return open_mesh(mesh_cache_path(obj_file).c_str(), obj_file);
+            } catch (const std::runtime_error &) {
+                // corrupted: rebuilt below
+            }
+        }
+        return build_mesh_cache(obj_file, threads);
+    }
+}
+
+#endif // _ALINE_MESH_CACHE_H_
@@ -0,0 +1,647 @@
+#ifndef _ALINE_OBJ_LOADER_H_
+#define _ALINE_OBJ_LOADER_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <thread>
+#include <future>
+#include <exception>
+#include <utility>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "shape.h"
+
+namespace aline {
+
+    // whole file mapped read-only in memory, unmapped on destruction
+    class MappedFile {
+        private:
+            const char * first;
+            size_t length;
+        public:
+            explicit MappedFile( const char * file_name ) {
+                first = nullptr;
+                length = 0;
+                int fd = ::open(file_name, O_RDONLY);
+                if (fd < 0)
+                    throw std::invalid_argument(std::string("can't open ") + file_name);
+                struct stat st;
+                if (::fstat(fd, &st) != 0) {
+                    ::close(fd);
+                    throw std::runtime_error(std::string("can't stat ") + file_name);
+                }
+                length = st.st_size;
+                // mmap refuses empty mappings, an empty file is an empty range
+                if (length > 0) {
+                    void * p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p == MAP_FAILED) {
+                        ::close(fd);
+                        throw std::runtime_error(std::string("can't map ") + file_name);
+                    }
+                    ::madvise(p, length, MADV_SEQUENTIAL);
+                    first = static_cast<const char *>(p);
+                }
+                ::close(fd);
+            }
+
+            MappedFile( const MappedFile & ) = delete;
+            MappedFile & operator=( const MappedFile & ) = delete;
+
+            ~MappedFile() {
+                if (first != nullptr)
+                    ::munmap(const_cast<char *>(first), length);
+            }
+
+            const char * begin() const {
+                return first;
+            }
+
+            const char * end() const {
+                return first + length;
+            }
+
+            size_t size() const {
+                return length;
+            }
+    };
+
+    namespace obj {
+
+        inline bool is_space( char c ) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline bool is_digit( char c ) {
+            return static_cast<unsigned char>(c - '0') < 10;
+        }
+
+        inline const char * skip_spaces( const char * p, const char * end ) {
+            while (p < end && is_space(*p))
+                p++;
+            return p;
+        }
+
+        inline const char * skip_line( const char * p, const char * end ) {
+            const void * nl = std::memchr(p, '\n', end - p);
+            return nl == nullptr ? end : static_cast<const char *>(nl) + 1;
+        }
+
+        // next token, up to a space or the end of the line
+        inline const char * skip_token( const char * p, const char * end ) {
+            while (p < end && !is_space(*p) && *p != '\n')
+                p++;
+            return p;
+        }
+
+        // decimal number with optional sign, fraction and exponent, as
+        // written by modelling tools; no locale, inf or nan. The digits are
+        // gathered in an integer which, as long as it fits in a double, is
+        // multiplied or divided by an exact power of ten: the result is the
+        // correctly rounded double, as strtod would give. Longer mantissas
+        // and larger exponents, rare in OBJ files, go through from_chars.
+        // Returns p when no number starts there.
+        inline const char * parse_real( const char * p, const char * end, double & value ) {
+            static const double powers[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            const char * start = p;
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+            const char * number = p;
+            uint64_t mantissa = 0;
+            int digits = 0;
+            int exponent = 0;
+            bool any = false;
+            for (; p < end && is_digit(*p); p++) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0)
+                        digits++;
+                } else {
+                    exponent++;
+                }
+            }
+            if (p < end && *p == '.') {
+                for (p++; p < end && is_digit(*p); p++) {
+                    any = true;
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + (*p - '0');
+                        if (mantissa != 0)
+                            digits++;
+                        exponent--;
+                    }
+                }
+            }
+            if (!any)
+                return start;
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                const char * q = p + 1;
+                bool negative_exponent = false;
+                if (q < end && (*q == '-' || *q == '+')) {
+                    negative_exponent = *q == '-';
+                    q++;
+                }
+                if (q < end && is_digit(*q)) {
+                    int e = 0;
+                    for (; q < end && is_digit(*q); q++)
+                        if (e < 10000)
+                            e = e * 10 + (*q - '0');
+                    exponent += negative_exponent ? -e : e;
+                    p = q;
+                }
+            }
+            double v = static_cast<double>(mantissa);
+            if (mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+                v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+            else if (mantissa != 0)
+                std::from_chars(number, p, v);
+            value = negative ? -v : v;
+            return p;
+        }
+
+        // indices are 32 bits: longer runs of digits stop growing at this
+        // limit, which the range checks reject, instead of overflowing
+        const long INDEX_LIMIT = INT32_MAX;
+
+        // decimal digits, saturated at INDEX_LIMIT
+        inline const char * parse_digits( const char * p, const char * end, long & value ) {
+            int64_t v = 0;
+            for (; p < end && is_digit(*p); p++)
+                if (v < INDEX_LIMIT)
+                    v = v * 10 + (*p - '0');
+            value = std::min<int64_t>(v, INDEX_LIMIT);
+            return p;
+        }
+
+        // optional sign and decimal digits; returns p when no integer starts there
+        inline const char * parse_int( const char * p, const char * end, long & value ) {
+            const char * start = p;
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+            if (p == end || !is_digit(*p))
+                return start;
+            long v = 0;
+            p = parse_digits(p, end, v);
+            value = negative ? -v : v;
+            return p;
+        }
+
+        // number of "v", "vt", "vn" and "f" lines, to reserve the streams
+        // up front
+        struct Counts {
+            size_t positions = 0;
+            size_t uvs = 0;
+            size_t normals = 0;
+            size_t faces = 0;
+        };
+
+        inline Counts count_elements( const char * p, const char * end ) {
+            Counts counts;
+            while (p < end) {
+                if (end - p > 2 && p[0] == 'v') {
+                    counts.positions += is_space(p[1]);
+                    counts.uvs += p[1] == 't' && is_space(p[2]);
+                    counts.normals += p[1] == 'n' && is_space(p[2]);
+                } else if (end - p > 1 && p[0] == 'f') {
+                    counts.faces += is_space(p[1]);
+                }
+                p = skip_line(p, end);
+            }
+            return counts;
+        }
+
+        const int32_t MISSING = INT32_MIN;
+        const uint32_t NONE = UINT32_MAX;
+
+        // one vertex of a face: its position, texture coordinate and normal
+        // indices, 0 based, MISSING when not given. A negative index of the
+        // file counts back from the elements read before the face: it is
+        // stored relative to the start of its chunk until the chunk offsets
+        // are known
+        struct Corner {
+            int32_t index[3];
+            uint8_t relative;   // bit a set when index[a] is relative
+        };
+
+        // "p", "p/t", "p//n" or "p/t/n"; read holds the number of positions,
+        // texture coordinates and normals already read in the chunk
+        inline const char * parse_corner( const char * p, const char * end, const size_t read[3], Corner & corner ) {
+            corner.index[0] = corner.index[1] = corner.index[2] = MISSING;
+            corner.relative = 0;
+            // "p" alone, the most common form
+            if (p < end && is_digit(*p)) {
+                long v = 0;
+                p = parse_digits(p, end, v);
+                if (v == 0 || v >= INDEX_LIMIT)
+                    throw std::runtime_error("OBJ file: face index out of range");
+                corner.index[0] = v - 1;
+                if (p == end || is_space(*p) || *p == '\n')
+                    return p;
+                if (*p != '/')
+                    throw std::runtime_error("OBJ file: bad face index");
+            }
+            for (int a = corner.index[0] == MISSING ? 0 : 1; a < 3; a++) {
+                if (a > 0) {
+                    if (p == end || *p != '/')
+                        break;
+                    p++;
+                }
+                long v = 0;
+                const char * q = parse_int(p, end, v);
+                if (q == p) {
+                    if (a == 0)
+                        throw std::runtime_error("OBJ file: bad face index");
+                    continue;
+                }
+                p = q;
+                if (v == 0 || v >= INDEX_LIMIT || v <= -INDEX_LIMIT)
+                    throw std::runtime_error("OBJ file: face index out of range");
+                if (v > 0) {
+                    corner.index[a] = v - 1;
+                } else {
+                    corner.index[a] = static_cast<int32_t>(read[a] + v);
+                    corner.relative |= 1 << a;
+                }
+            }
+            if (p < end && !is_space(*p) && *p != '\n')
+                throw std::runtime_error("OBJ file: bad face index");
+            return p;
+        }
+
+        // elements of a range of lines of an OBJ file, the faces cut into
+        // triangles of three corners each
+        struct Chunk {
+            AlignedVector<float> xs;
+            AlignedVector<float> ys;
+            AlignedVector<float> zs;
+            AlignedVector<float> us;
+            AlignedVector<float> vs;
+            AlignedVector<float> nxs;
+            AlignedVector<float> nys;
+            AlignedVector<float> nzs;
+            std::vector<Corner> corners;
+            bool uses_uvs = false;
+            bool uses_normals = false;
+        };
+
+        // count numbers of a line, the ones after the first optional ones
+        // defaulting to 0; returns the end of the last one read
+        inline const char * parse_reals( const char * p, const char * end, double * values, int count, int required ) {
+            for (int i = 0; i < count; i++) {
+                p = skip_spaces(p, end);
+                const char * q = parse_real(p, end, values[i]);
+                if (q == p) {
+                    if (i < required)
+                        throw std::runtime_error("OBJ file: bad vertex coordinate");
+                    values[i] = 0;
+                    continue;
+                }
+                p = q;
+            }
+            return p;
+        }
+
+        // "v x y z", "vt u [v]" and "vn x y z" elements, extra components
+        // ignored, and "f" faces of three corners or more, cut into a fan of
+        // triangles around their first corner; every other line is ignored
+        inline void parse_chunk( const char * begin, const char * end, Chunk & chunk ) {
+            Counts counts = count_elements(begin, end);
+            chunk.xs.reserve(counts.positions);
+            chunk.ys.reserve(counts.positions);
+            chunk.zs.reserve(counts.positions);
+            chunk.us.reserve(counts.uvs);
+            chunk.vs.reserve(counts.uvs);
+            chunk.nxs.reserve(counts.normals);
+            chunk.nys.reserve(counts.normals);
+            chunk.nzs.reserve(counts.normals);
+            chunk.corners.reserve(3 * counts.faces);
+
+            const char * p = begin;
+            while (p < end) {
+                p = skip_spaces(p, end);
+                if (end - p > 1 && p[0] == 'v' && is_space(p[1])) {
+                    double c[3];
+                    p = parse_reals(p + 2, end, c, 3, 3);
+                    chunk.xs.push_back(c[0]);
+                    chunk.ys.push_back(c[1]);
+                    chunk.zs.push_back(c[2]);
+                } else if (end - p > 2 && p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+                    double c[2];
+                    p = parse_reals(p + 3, end, c, 2, 1);
+                    chunk.us.push_back(c[0]);
+                    chunk.vs.push_back(c[1]);
+                } else if (end - p > 2 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+                    double c[3];
+                    p = parse_reals(p + 3, end, c, 3, 3);
+                    chunk.nxs.push_back(c[0]);
+                    chunk.nys.push_back(c[1]);
+                    chunk.nzs.push_back(c[2]);
+                } else if (end - p > 1 && p[0] == 'f' && is_space(p[1])) {
+                    const size_t read[3] = {chunk.xs.size(), chunk.us.size(), chunk.nxs.size()};
+                    Corner first;
+                    Corner previous;
+                    int n = 0;
+                    p += 2;
+                    while (true) {
+                        p = skip_spaces(p, end);
+                        if (p == end || *p == '\n' || *p == '#')
+                            break;
+                        Corner corner;
+                        p = parse_corner(p, end, read, corner);
+                        chunk.uses_uvs = chunk.uses_uvs || corner.index[1] != MISSING;
+                        chunk.uses_normals = chunk.uses_normals || corner.index[2] != MISSING;
+                        if (n == 0) {
+                            first = corner;
+                        } else if (n >= 2) {
+                            chunk.corners.push_back(first);
+                            chunk.corners.push_back(previous);
+                            chunk.corners.push_back(corner);
+                        }
+                        previous = corner;
+                        n++;
+                    }
+                    if (n < 3)
+                        throw std::runtime_error("OBJ file: face with less than three vertices");
+                }
+                p = skip_line(p, end);
+            }
+        }
+
+        // count + 1 bounds cutting [begin, end) into count ranges of about
+        // the same size, each one ending after a newline
+        inline std::vector<const char *> split_lines( const char * begin, const char * end, size_t count ) {
+            std::vector<const char *> bounds(count + 1, end);
+            bounds[0] = begin;
+            for (size_t i = 1; i < count; i++) {
+                const char * p = begin + (end - begin) * i / count;
+                p = p == begin ? p : skip_line(p - 1, end);
+                bounds[i] = std::max(p, bounds[i - 1]);
+            }
+            return bounds;
+        }
+
+        // runs f(0) to f(count - 1) on count threads, the caller's included,
+        // and rethrows the first exception one of them threw
+        template <class F>
+        void run_parallel( size_t count, F f ) {
+            std::vector<std::future<void>> others;
+            for (size_t i = 1; i < count; i++)
+                others.push_back(std::async(std::launch::async, f, i));
+            std::exception_ptr error;
+            try {
+                f(0);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            for (std::future<void> & other : others) {
+                try {
+                    other.get();
+                } catch (...) {
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        // open addressing hash map from (position, texture coordinate,
+        // normal) index triples to welded vertex indices: linear probing in
+        // a power of two table kept at most half full
+        class CornerMap {
+            private:
+                struct Slot {
+                    uint32_t key[3];
+                    uint32_t value;
+                };
+                std::vector<Slot> slots;
+                size_t count = 0;
+
+                static size_t hash( uint32_t p, uint32_t t, uint32_t n ) {
+                    uint64_t h = p * 0x9E3779B97F4A7C15ull ^ t * 0xC2B2AE3D27D4EB4Full ^ n * 0x165667B19E3779F9ull;
+                    return h ^ (h >> 29);
+                }
+
+                Slot & find( uint32_t p, uint32_t t, uint32_t n ) {
+                    const size_t mask = slots.size() - 1;
+                    size_t i = hash(p, t, n) & mask;
+                    while (slots[i].value != NONE && (slots[i].key[0] != p || slots[i].key[1] != t || slots[i].key[2] != n))
+                        i = (i + 1) & mask;
+                    return slots[i];
+                }
+
+                void grow() {
+                    std::vector<Slot> old(2 * slots.size(), Slot {{0, 0, 0}, NONE});
+                    old.swap(slots);
+                    for (const Slot & s : old)
+                        if (s.value != NONE)
+                            find(s.key[0], s.key[1], s.key[2]) = s;
+                }
+            public:
+                explicit CornerMap( size_t expected ) {
+                    size_t size = 16;
+                    while (size < 2 * expected)
+                        size *= 2;
+                    slots.assign(size, Slot {{0, 0, 0}, NONE});
+                }
+
+                size_t size() const {
+                    return count;
+                }
+
+                // the value of the triple, given value when it is a new one
+                uint32_t insert( uint32_t p, uint32_t t, uint32_t n, uint32_t value ) {
+                    if (2 * (count + 1) > slots.size())
+                        grow();
+                    Slot & s = find(p, t, n);
+                    if (s.value == NONE) {
+                        s = Slot {{p, t, n}, value};
+                        count++;
+                    }
+                    return s.value;
+                }
+        };
+
+        // the streams of the whole file, concatenated from its chunks
+        struct Elements {
+            AlignedVector<float> xs;
+            AlignedVector<float> ys;
+            AlignedVector<float> zs;
+            AlignedVector<float> us;
+            AlignedVector<float> vs;
+            AlignedVector<float> nxs;
+            AlignedVector<float> nys;
+            AlignedVector<float> nzs;
+            // per corner, its position index alone when no face uses texture
+            // coordinates or normals, else position, texture coordinate and
+            // normal indices, the last two NONE when missing
+            AlignedVector<uint> corners;
+        };
+
+        // one vertex per distinct (position, texture coordinate, normal)
+        // triple, in the order of their first use, so that a vertex shared
+        // by faces is transformed once; a corner without a texture
+        // coordinate or a normal gets zeros
+        inline MeshStreams weld( Elements & e, bool with_uvs, bool with_normals ) {
+            const size_t corner_count = e.corners.size() / 3;
+            MeshStreams mesh;
+            mesh.indices.resize(corner_count);
+            CornerMap map(std::min(corner_count, 2 * e.xs.size()));
+            for (size_t c = 0; c < corner_count; c++) {
+                const uint p = e.corners[3 * c];
+                const uint t = with_uvs ? e.corners[3 * c + 1] : NONE;
+                const uint n = with_normals ? e.corners[3 * c + 2] : NONE;
+                const uint vertex = mesh.xs.size();
+                mesh.indices[c] = map.insert(p, t, n, vertex);
+                if (mesh.indices[c] != vertex)
+                    continue;
+                mesh.xs.push_back(e.xs[p]);
+                mesh.ys.push_back(e.ys[p]);
+                mesh.zs.push_back(e.zs[p]);
+                if (with_uvs) {
+                    mesh.us.push_back(t == NONE ? 0 : e.us[t]);
+                    mesh.vs.push_back(t == NONE ? 0 : e.vs[t]);
+                }
+                if (with_normals) {
+                    mesh.nxs.push_back(n == NONE ? 0 : e.nxs[n]);
+                    mesh.nys.push_back(n == NONE ? 0 : e.nys[n]);
+                    mesh.nzs.push_back(n == NONE ? 0 : e.nzs[n]);
+                }
+            }
+            return mesh;
+        }
+
+        template <class T>
+        void append_at( const AlignedVector<T> & from, AlignedVector<T> & to, size_t offset ) {
+            std::copy(from.begin(), from.end(), to.begin() + offset);
+        }
+    }
+
+    // below this size a file is not worth another thread
+    const size_t OBJ_CHUNK_SIZE = 1 << 20;
+
+    // builds a Shape from the OBJ text in [begin, end). The text is cut on
+    // newlines into chunks parsed by up to threads threads, then the
+    // chunks are copied, in parallel too, at the offsets given by the
+    // prefix sums of their element counts, which also turn the negative
+    // indices into file-wide ones. Without texture coordinates or normals
+    // in the faces the positions are the vertices; otherwise the distinct
+    // corners are welded into the vertices, see obj::weld
+    inline Shape parse_obj( const std::string & name, const char * begin, const char * end,
+                            unsigned threads = std::thread::hardware_concurrency(), size_t chunk_size = OBJ_CHUNK_SIZE ) {
+        size_t count = std::max<size_t>(1, std::min<size_t>(std::max(threads, 1u), (end - begin) / std::max<size_t>(chunk_size, 1)));
+        std::vector<const char *> bounds = obj::split_lines(begin, end, count);
+        std::vector<obj::Chunk> chunks(count);
+        obj::run_parallel(count, [&](size_t i) {
+            obj::parse_chunk(bounds[i], bounds[i + 1], chunks[i]);
+        });
+
+        // offsets[a][i]: positions, texture coordinates, normals and
+        // corners of the chunks before chunk i
+        std::vector<size_t> offsets[4];
+        for (std::vector<size_t> & o : offsets)
+            o.assign(count + 1, 0);
+        bool with_uvs = false;
+        bool with_normals = false;
+        for (size_t i = 0; i < count; i++) {
+            offsets[0][i + 1] = offsets[0][i] + chunks[i].xs.size();
+            offsets[1][i + 1] = offsets[1][i] + chunks[i].us.size();
+            offsets[2][i + 1] = offsets[2][i] + chunks[i].nxs.size();
+            offsets[3][i + 1] = offsets[3][i] + chunks[i].corners.size();
+            with_uvs = with_uvs || chunks[i].uses_uvs;
+            with_normals = with_normals || chunks[i].uses_normals;
+        }
+        const size_t totals[3] = {offsets[0][count], offsets[1][count], offsets[2][count]};
+        if (totals[0] > UINT32_MAX || offsets[3][count] > UINT32_MAX)
+            throw std::runtime_error("OBJ file: too many vertices");
+
+        obj::Elements e;
+        if (count == 1) {
+            e.xs = std::move(chunks[0].xs);
+            e.ys = std::move(chunks[0].ys);
+            e.zs = std::move(chunks[0].zs);
+            e.us = std::move(chunks[0].us);
+            e.vs = std::move(chunks[0].vs);
+            e.nxs = std::move(chunks[0].nxs);
+            e.nys = std::move(chunks[0].nys);
+            e.nzs = std::move(chunks[0].nzs);
+        } else {
+            e.xs.resize(totals[0]);
+            e.ys.resize(totals[0]);
+            e.zs.resize(totals[0]);
+            e.us.resize(totals[1]);
+            e.vs.resize(totals[1]);
+            e.nxs.resize(totals[2]);
+            e.nys.resize(totals[2]);
+            e.nzs.resize(totals[2]);
+        }
+        const int stride = with_uvs || with_normals ? 3 : 1;
+        e.corners.resize(stride * offsets[3][count]);
+        obj::run_parallel(count, [&](size_t i) {
+            obj::Chunk & chunk = chunks[i];
+            if (count > 1) {
+                obj::append_at(chunk.xs, e.xs, offsets[0][i]);
+                obj::append_at(chunk.ys, e.ys, offsets[0][i]);
+                obj::append_at(chunk.zs, e.zs, offsets[0][i]);
+                obj::append_at(chunk.us, e.us, offsets[1][i]);
+                obj::append_at(chunk.vs, e.vs, offsets[1][i]);
+                obj::append_at(chunk.nxs, e.nxs, offsets[2][i]);
+                obj::append_at(chunk.nys, e.nys, offsets[2][i]);
+                obj::append_at(chunk.nzs, e.nzs, offsets[2][i]);
+            }
+            // faces may come before the elements they use, checked here
+            // once every count is known
+            uint * out = e.corners.data() + stride * offsets[3][i];
+            for (const obj::Corner & corner : chunk.corners) {
+                for (int a = 0; a < stride; a++) {
+                    int64_t index = corner.index[a];
+                    if (index == obj::MISSING) {
+                        *out++ = obj::NONE;
+                        continue;
+                    }
+                    if (corner.relative & (1 << a))
+                        index += offsets[a][i];
+                    if (index < 0 || uint64_t(index) >= totals[a])
+                        throw std::runtime_error("OBJ file: face index out of range");
+                    *out++ = index;
+                }
+            }
+            chunk = obj::Chunk();
+        });
+
+        MeshStreams mesh;
+        if (with_uvs || with_normals) {
+            mesh = obj::weld(e, with_uvs, with_normals);
+        } else {
+            mesh.xs = std::move(e.xs);
+            mesh.ys = std::move(e.ys);
+            mesh.zs = std::move(e.zs);
+            mesh.indices = std::move(e.corners);
+        }
+        mesh.colors.assign(mesh.indices.size() / 3, minwin::WHITE);
+        return Shape(name, std::move(mesh));
+    }
+
+    inline Shape load_obj( const char * file_name, unsigned threads = std::thread::hardware_concurrency() ) {
+        MappedFile file(file_name);
+        return parse_obj(file_name, file.begin(), file.end(), threads);
+    }
+}
+
+#endif // _ALINE_OBJ_LOADER_H_
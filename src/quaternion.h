@@ -0,0 +1,127 @@
+#ifndef _ALINE_QUATERNION_H_
+#define _ALINE_QUATERNION_H_
+
+#include <cmath>
+#include "vector.h"
+#include "matrix.h"
+
+namespace aline {
+
+    // rotation quaternion w + xi + yj + zk, kept as its scalar part w and its
+    // vector part (x, y, z); the default one is the identity
+    template <class T>
+    class Quaternion {
+        private:
+            T w;
+            Vector<T, 3> v;
+        public:
+            constexpr Quaternion() {
+                this->w = 1;
+            }
+
+            constexpr Quaternion(T w, const Vector<T, 3> & v) {
+                this->w = w;
+                this->v = v;
+            }
+
+            constexpr T get_scalar() const {
+                return w;
+            }
+
+            constexpr const Vector<T, 3> & get_vector() const {
+                return v;
+            }
+    };
+
+    // composition: p * q rotates by q first, then by p
+    template <class T> constexpr Quaternion<T> operator*(const Quaternion<T>& p, const Quaternion<T>& q) {
+        const T pw = p.get_scalar();
+        const T qw = q.get_scalar();
+        const Vector<T, 3> & pv = p.get_vector();
+        const Vector<T, 3> & qv = q.get_vector();
+        return Quaternion<T>(pw * qw - dot(pv, qv), pw * qv + qw * pv + cross(pv, qv));
+    }
+
+    template <class T> constexpr Quaternion<T> operator-(const Quaternion<T>& q) {
+        return Quaternion<T>(-q.get_scalar(), -q.get_vector());
+    }
+
+    template <class T> constexpr Quaternion<T> conjugate(const Quaternion<T>& q) {
+        return Quaternion<T>(q.get_scalar(), -q.get_vector());
+    }
+
+    template <class T> constexpr T dot(const Quaternion<T>& p, const Quaternion<T>& q) {
+        return p.get_scalar() * q.get_scalar() + dot(p.get_vector(), q.get_vector());
+    }
+
+    template <class T> T norm(const Quaternion<T>& q) {
+        return std::sqrt(dot(q, q));
+    }
+
+    // incremental updates drift away from unit length, renormalizing
+    // is only a square root
+    template <class T> Quaternion<T> unit_quaternion(const Quaternion<T>& q) {
+        T n = norm(q);
+        return Quaternion<T>(q.get_scalar() / n, q.get_vector() / n);
+    }
+
+    // counter-clockwise rotation by angle radians around the unit vector axis
+    template <class T> constexpr Quaternion<T> from_axis_angle(const Vector<T, 3>& axis, T angle) {
+        return Quaternion<T>(constexpr_cos(angle / 2), axis * constexpr_sin(angle / 2));
+    }
+
+    // the rotation Object and Camera used to build from Euler angles (in
+    // radians): x, then y, then z, each one clockwise
+    template <class T> constexpr Quaternion<T> from_euler(const Vector<T, 3>& angles) {
+        return from_axis_angle(Vector<T, 3> {1, 0, 0}, -angles[0])
+             * from_axis_angle(Vector<T, 3> {0, 1, 0}, -angles[1])
+             * from_axis_angle(Vector<T, 3> {0, 0, 1}, -angles[2]);
+    }
+
+    // rotation matrix of a unit quaternion, no trigonometry involved
+    template <class T> constexpr Matrix<T, 4, 4> to_matrix(const Quaternion<T>& q) {
+        const T w = q.get_scalar();
+        const T x = q.get_vector()[0];
+        const T y = q.get_vector()[1];
+        const T z = q.get_vector()[2];
+        return Matrix<T, 4, 4> {
+            {1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y), 0},
+            {2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x), 0},
+            {2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y), 0},
+            {0, 0, 0, 1}
+        };
+    }
+
+    template <class T> constexpr Vector<T, 3> rotate(const Quaternion<T>& q, const Vector<T, 3>& u) {
+        const T w = q.get_scalar();
+        const Vector<T, 3> & v = q.get_vector();
+        const Vector<T, 3> t = T(2) * cross(v, u);
+        return u + w * t + cross(v, t);
+    }
+
+    // spherical interpolation between unit quaternions a (t = 0) and b
+    // (t = 1), along the shortest arc
+    template <class T> Quaternion<T> slerp(const Quaternion<T>& a, const Quaternion<T>& b, T t) {
+        Quaternion<T> c = b;
+        T cos_theta = dot(a, b);
+        if (cos_theta < 0) {
+            c = -b;
+            cos_theta = -cos_theta;
+        }
+        T ka = 1 - t;
+        T kc = t;
+        // almost the same rotation: linear interpolation, renormalized below
+        if (cos_theta < 1 - 1e-6) {
+            T theta = std::acos(cos_theta);
+            T s = std::sin(theta);
+            ka = std::sin((1 - t) * theta) / s;
+            kc = std::sin(t * theta) / s;
+        }
+        return unit_quaternion(Quaternion<T>(ka * a.get_scalar() + kc * c.get_scalar(),
+                                             ka * a.get_vector() + kc * c.get_vector()));
+    }
+}
+
+using Quatr = aline::Quaternion<real>;
+
+#endif // _ALINE_QUATERNION_H_
@@ -0,0 +1,165 @@
+#ifndef _ALINE_RENDER_TARGET_H_
+#define _ALINE_RENDER_TARGET_H_
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <window.h>
+#include "ibehavior.h"
+#include "framebuffer.h"
+
+namespace aline {
+
+    // where Scene sends its finished frames and reads its input from
+    class RenderTarget {
+        public:
+            virtual ~RenderTarget() {}
+
+            virtual int get_width() const = 0;
+            virtual int get_height() const = 0;
+
+            virtual void register_quit_behavior( minwin::IButtonBehavior * const behavior ) = 0;
+            virtual void register_key_behavior( minwin::KeyCode key, minwin::IKeyBehavior * const behavior ) = 0;
+
+            virtual bool open() = 0;
+            virtual void process_input() = 0;
+            virtual void present( const ColorBuffer & framebuffer ) = 0;
+            virtual void close() = 0;
+    };
+
+    class WindowTarget : public RenderTarget {
+        private:
+            minwin::Window window;
+            int width;
+            int height;
+        public:
+            WindowTarget( const std::string & title, int width, int height ) {
+                this->width = width;
+                this->height = height;
+                window.set_title(title);
+                window.set_width(width);
+                window.set_height(height);
+            }
+
+            int get_width() const {
+                return width;
+            }
+
+            int get_height() const {
+                return height;
+            }
+
+            void register_quit_behavior( minwin::IButtonBehavior * const behavior ) {
+                window.register_quit_behavior(behavior);
+            }
+
+            void register_key_behavior( minwin::KeyCode key, minwin::IKeyBehavior * const behavior ) {
+                window.register_key_behavior(key, behavior);
+            }
+
+            bool open() {
+                return window.open();
+            }
+
+            void process_input() {
+                window.process_input();
+            }
+
+            // minwin only exposes put_pixel, so the upload skips background
+            // pixels and only changes the draw color between runs of different colors;
+            // it still costs one put_pixel call per drawn pixel, not one blit
+            void present( const ColorBuffer & framebuffer ) {
+                const minwin::Color background = framebuffer.get_clear_color();
+                window.clear(background);
+                minwin::Color current = background;
+                const minwin::Color * p = framebuffer.data();
+                for (int y = 0; y < framebuffer.get_height(); y++) {
+                    for (int x = 0; x < framebuffer.get_width(); x++, p++) {
+                        if (ColorBuffer::same_color(*p, background))
+                            continue;
+                        if (!ColorBuffer::same_color(*p, current)) {
+                            current = *p;
+                            window.set_draw_color(current);
+                        }
+                        window.put_pixel(x, y);
+                    }
+                }
+                window.display();
+            }
+
+            void close() {
+                window.close();
+            }
+    };
+
+    // in-memory target for machines without a display: renders a fixed
+    // number of frames, optionally dumping each one as a PPM file
+    class HeadlessTarget : public RenderTarget {
+        private:
+            int width;
+            int height;
+            unsigned int frame_count;
+            unsigned int max_frames;
+            std::string dump_prefix;
+            minwin::IButtonBehavior * quit_behavior;
+        public:
+            HeadlessTarget( int width, int height, unsigned int max_frames, const std::string & dump_prefix = "" ) {
+                this->width = width;
+                this->height = height;
+                this->max_frames = max_frames;
+                this->dump_prefix = dump_prefix;
+                frame_count = 0;
+                quit_behavior = nullptr;
+            }
+
+            ~HeadlessTarget() {
+                close();
+            }
+
+            int get_width() const {
+                return width;
+            }
+
+            int get_height() const {
+                return height;
+            }
+
+            unsigned int get_frame_count() const {
+                return frame_count;
+            }
+
+            void register_quit_behavior( minwin::IButtonBehavior * const behavior ) {
+                delete quit_behavior;
+                quit_behavior = behavior;
+            }
+
+            // there is no keyboard; like minwin::Window, key behaviors are not owned
+            void register_key_behavior( minwin::KeyCode, minwin::IKeyBehavior * const ) {}
+
+            bool open() {
+                frame_count = 0;
+                return true;
+            }
+
+            void process_input() {
+                if (frame_count >= max_frames && quit_behavior != nullptr)
+                    quit_behavior->on_click();
+            }
+
+            void present( const ColorBuffer & framebuffer ) {
+                if (!dump_prefix.empty()) {
+                    std::ostringstream file_name;
+                    file_name << dump_prefix << std::setw(4) << std::setfill('0') << frame_count << ".ppm";
+                    framebuffer.write_ppm(file_name.str());
+                }
+                frame_count++;
+            }
+
+            void close() {
+                delete quit_behavior;
+                quit_behavior = nullptr;
+            }
+    };
+}
+
+#endif // _ALINE_RENDER_TARGET_H_
@@ -1,113 +1,385 @@
+#ifndef _ALINE_SCENE_H_
+#define _ALINE_SCENE_H_
+
 #include <vector>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <stdexcept>
 #include <memory>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cmath>
+#include <thread>
+#include <exception>
 #include "shape.h"
-#include <window.h>
-#include "ibehavior.h"
+#include "mesh_cache.h"
+#include "concurrent_queue.h"
+#include "framebuffer.h"
+#include "render_target.h"
+#include "halfspace.h"
+#include "tiler.h"
+#include "arena.h"
+#include "alloc_counter.h"
 
 #define VIEWPORT_WIDTH 2.0
 #define CANVAS_WIDTH 800
 #define CANVAS_HEIGHT 800
+#define VIEWPORT_DISTANCE 50
 
 namespace aline {
 
-    class Scene {
+    // counters of the last rendered frame
+    struct FrameStats {
+        unsigned long allocations = 0;
+        unsigned long vertices_transformed = 0;
+        unsigned long matrix_rebuilds = 0;
+        unsigned long objects_visible = 0;
+        unsigned long objects_culled = 0;
+        unsigned long triangles_clipped = 0;
+        unsigned long triangles_culled = 0;
+    };
+
+    // projected vertex: window coordinates and 1/z
+    template <class S>
+    struct ScreenVertex {
+        Vec2i p;
+        S z;
+    };
+
+    // the render pipeline, from the camera space vertex streams to the
+    // depth buffer, runs in the scalar type S; object and camera transforms
+    // stay in real and are converted once per object
+    template <class S>
+    class BasicScene {
         private:
-            minwin::Window window;
+            using Vec2 = Vector<S, 2>;
+            using Vec3 = Vector<S, 3>;
+            using Vec4 = Vector<S, 4>;
+
+            std::unique_ptr<RenderTarget> target;
+            BasicFramebuffer<S> framebuffer;
+            TileRenderer<S> tiler;
+            FrameArena arena;
+            FrameStats stats;
+            // post-transform vertex cache of the object being drawn, the
+            // camera space streams come first and are projected afterwards
+            AlignedVector<S> view_x;
+            AlignedVector<S> view_y;
+            AlignedVector<S> view_z;
+            std::vector<ScreenVertex<S>> projected;
+            // filled triangles the tiler could not bin, drawn after its flush
+            std::vector<ScreenVertex<S>> deferred;
+            std::vector<minwin::Color> deferred_colors;
             bool running { true };
             int display = 0;
+            int rasterizer = 0;
             std::vector<Object> objects;
+            // shapes loaded from files, the objects point into them
+            std::vector<std::unique_ptr<Shape>> shapes;
+            // files are loaded in the background, one thread each, and their
+            // shapes handed to the render loop as they are ready
+            struct LoadedShape {
+                std::unique_ptr<Shape> shape;
+                std::exception_ptr error;
+            };
+            ConcurrentQueue<LoadedShape> loaded;
+            std::vector<std::thread> loaders;
+            size_t pending = 0;
+            // headless runs wait for every file before the first frame, so
+            // that their images do not depend on the loading time
+            bool wait_for_files = false;
+            std::vector<std::pair<real, size_t>> draw_order;
             Camera camera = Camera(CANVAS_WIDTH/CANVAS_HEIGHT);
-
+            // camera space to homogeneous window coordinates, the same
+            // mapping as perspective_projection and to_screen
+            Mat44r projection;
+            // near plane and guard band planes in camera space, see outcode();
+            // the guard band is half the one of the half-space rasterizer so
+            // that clipped triangles never fall back to the scanline path
+            static const int CLIP_PLANES = 5;
+            static constexpr real CLIP_GUARD_BAND = halfspace::GUARD_BAND / 2;
+            Vec4 clip_planes[CLIP_PLANES];
+            std::vector<uint8_t> outcodes;
+            // per face of the object being drawn, see draw_object
+            AlignedVector<S> facing;
+
+            // transforms and projects every vertex of the object once, the
+            // triangles are then set up from the projected vertices
             void draw_object(const Object &o) {
-                Mat44r transform = camera.transform() * o.transform();
-
-                for (Face f : o.get_faces()) {
-                    // set color
-                    window.set_draw_color(f.get_color());
-                    Vertex vert0 = o.get_vertices()[f.get_v0()];
-                    Vertex vert1 = o.get_vertices()[f.get_v1()];
-                    Vertex vert2 = o.get_vertices()[f.get_v2()];
-                    Vec4r vec0 { vert0.get_vector()[0], vert0.get_vector()[1], vert0.get_vector()[2], 1.0 };
-                    Vec4r vec1 { vert1.get_vector()[0], vert1.get_vector()[1], vert1.get_vector()[2], 1.0 };
-                    Vec4r vec2 { vert2.get_vector()[0], vert2.get_vector()[1], vert2.get_vector()[2], 1.0 };
-
-                    //perspective projection
-                    Vec2r v0 = perspective_projection(transform * vec0, 50);
-                    Vec2r v1 = perspective_projection(transform * vec1, 50);
-                    Vec2r v2 = perspective_projection(transform * vec2 , 50);
+                const Shape & shape = o.get_shape();
+                const size_t n = shape.vertex_count();
+                const Mat44r & transform = o.model_view(camera.transform(), camera.get_version());
+                view_x.resize(n);
+                view_y.resize(n);
+                view_z.resize(n);
+                projected.resize(n);
+                outcodes.resize(n);
+
+                // unit stride over the coordinate streams with the matrix
+                // coefficients in locals, which the compiler vectorizes
+                const float * xs = shape.get_x().data();
+                const float * ys = shape.get_y().data();
+                const float * zs = shape.get_z().data();
+                S * vx = view_x.data();
+                S * vy = view_y.data();
+                S * vz = view_z.data();
+                const S m00 = transform[0][0], m01 = transform[0][1], m02 = transform[0][2], m03 = transform[0][3];
+                const S m10 = transform[1][0], m11 = transform[1][1], m12 = transform[1][2], m13 = transform[1][3];
+                const S m20 = transform[2][0], m21 = transform[2][1], m22 = transform[2][2], m23 = transform[2][3];
+                for (size_t i = 0; i < n; i++) {
+                    const S x = xs[i], y = ys[i], z = zs[i];
+                    vx[i] = m00 * x + m01 * y + m02 * z + m03;
+                    vy[i] = m10 * x + m11 * y + m12 * z + m13;
+                    vz[i] = m20 * x + m21 * y + m22 * z + m23;
+                }
+                // vertices outside a clip plane are only projected once clipped
+                for (size_t i = 0; i < n; i++) {
+                    outcodes[i] = outcode(Vec3 {vx[i], vy[i], vz[i]});
+                    if (outcodes[i] == 0)
+                        projected[i] = project(Vec3 {vx[i], vy[i], vz[i]});
+                }
+                stats.vertices_transformed += n;
+
+                const View<uint> indices = shape.get_indices();
+                const View<minwin::Color> colors = shape.get_colors();
+                const size_t face_count = colors.size();
+
+                // (p1 - p0) x (p2 - p0) . p0 in camera space, the camera being
+                // at the origin: positive when the face points away from it,
+                // which is the sign of the window space winding; one branch
+                // free pass over the faces, left to the compiler to vectorize
+                facing.resize(face_count);
+                S * fc = facing.data();
+                const uint * idx = indices.data();
+                for (size_t f = 0; f < face_count; f++) {
+                    const uint a = idx[3 * f], b = idx[3 * f + 1], c = idx[3 * f + 2];
+                    const S ux = vx[b] - vx[a], uy = vy[b] - vy[a], uz = vz[b] - vz[a];
+                    const S wx = vx[c] - vx[a], wy = vy[c] - vy[a], wz = vz[c] - vz[a];
+                    fc[f] = (uy * wz - uz * wy) * vx[a] + (uz * wx - ux * wz) * vy[a] + (ux * wy - uy * wx) * vz[a];
+                }
+                const S cull_sign = o.get_cull_mode() == CullMode::Back ? 1 : o.get_cull_mode() == CullMode::Front ? -1 : 0;
 
-                    if (display == 0) {
-                        draw_wireframe_triangle(v0, v1, v2);
+                for (size_t f = 0; f < face_count; f++) {
+                    if (cull_sign * fc[f] > 0) {
+                        stats.triangles_culled++;
+                        continue;
                     }
-                    else if (display == 1) {
-                        draw_filled_triangle(v0, v1, v2);
+                    const minwin::Color color = colors[f];
+                    const uint i0 = indices[3 * f];
+                    const uint i1 = indices[3 * f + 1];
+                    const uint i2 = indices[3 * f + 2];
+
+                    // entirely outside one plane, or crossing some of them
+                    if (outcodes[i0] & outcodes[i1] & outcodes[i2])
+                        continue;
+                    if (outcodes[i0] | outcodes[i1] | outcodes[i2]) {
+                        stats.triangles_clipped++;
+                        draw_clipped_triangle(i0, i1, i2, outcodes[i0] | outcodes[i1] | outcodes[i2], color);
+                        continue;
                     }
+
+                    const ScreenVertex<S> & v0 = projected[i0];
+                    const ScreenVertex<S> & v1 = projected[i1];
+                    const ScreenVertex<S> & v2 = projected[i2];
+                    if (display == 0)
+                        draw_wireframe_triangle(v0, v1, v2, color);
+                    else if (display == 1)
+                        fill_triangle(v0, v1, v2, color);
+                }
+            }
+
+            void fill_triangle( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const ScreenVertex<S> & v2, const minwin::Color & color ) {
+                if (rasterizer == 1)
+                    draw_filled_triangle_halfspace(v0, v1, v2, color);
+                else if (rasterizer == 2)
+                    bin_filled_triangle(v0, v1, v2, color);
+                else
+                    draw_filled_triangle(v0, v1, v2, color);
+            }
+
+            // the near plane of the camera frustum and the window rectangle
+            // widened by the guard band, from the rows of the projection
+            void set_clip_planes() {
+                const Vec4r & rx = projection[0];
+                const Vec4r & ry = projection[1];
+                const Vec4r & rw = projection[3];
+                const Vec4r planes[CLIP_PLANES] = {
+                    Vec4r {0, 0, 1, -camera.get_frustum().get_near_distance()},
+                    rx + CLIP_GUARD_BAND * rw,
+                    CLIP_GUARD_BAND * rw - rx,
+                    ry + CLIP_GUARD_BAND * rw,
+                    CLIP_GUARD_BAND * rw - ry
+                };
+                for (int k = 0; k < CLIP_PLANES; k++)
+                    for (int j = 0; j < 4; j++)
+                        clip_planes[k][j] = planes[k][j];
+            }
+
+            S plane_distance( int k, const Vec3 & p ) const {
+                return clip_planes[k][0] * p[0] + clip_planes[k][1] * p[1] + clip_planes[k][2] * p[2] + clip_planes[k][3];
+            }
+
+            // bit k is set when the camera space point p is outside clip plane k
+            uint8_t outcode( const Vec3 & p ) const {
+                uint8_t code = 0;
+                for (int k = 0; k < CLIP_PLANES; k++)
+                    if (plane_distance(k, p) < 0)
+                        code |= 1 << k;
+                return code;
+            }
+
+            ScreenVertex<S> project( const Vec3 & p ) {
+                return to_screen(perspective_projection(Vec4 {p[0], p[1], p[2], 1}, VIEWPORT_DISTANCE));
+            }
+
+            // Sutherland-Hodgman: the part of the convex polygon in (count
+            // vertices) inside clip plane k, written to out
+            int clip_polygon( int k, const Vec3 * in, int count, Vec3 * out ) const {
+                int m = 0;
+                for (int i = 0; i < count; i++) {
+                    const Vec3 & a = in[i];
+                    const Vec3 & b = in[(i + 1) % count];
+                    S da = plane_distance(k, a);
+                    S db = plane_distance(k, b);
+                    if (da >= 0)
+                        out[m++] = a;
+                    if ((da >= 0) != (db >= 0))
+                        out[m++] = a + (b - a) * (da / (da - db));
+                }
+                return m;
+            }
+
+            // triangle (i0, i1, i2) of the view streams clipped against the
+            // planes of mask; filled triangles are clipped as a polygon which
+            // is drawn as a fan, wireframe ones edge by edge
+            void draw_clipped_triangle( uint i0, uint i1, uint i2, uint8_t mask, const minwin::Color & color ) {
+                Vec3 polygon[2][3 + CLIP_PLANES];
+                polygon[0][0] = {view_x[i0], view_y[i0], view_z[i0]};
+                polygon[0][1] = {view_x[i1], view_y[i1], view_z[i1]};
+                polygon[0][2] = {view_x[i2], view_y[i2], view_z[i2]};
+
+                if (display == 0) {
+                    for (int e = 0; e < 3; e++)
+                        draw_clipped_line(polygon[0][e], polygon[0][(e + 1) % 3], mask, color);
+                    return;
+                }
+
+                int count = 3;
+                int current = 0;
+                for (int k = 0; k < CLIP_PLANES && count >= 3; k++) {
+                    if (!(mask & (1 << k)))
+                        continue;
+                    count = clip_polygon(k, polygon[current], count, polygon[1 - current]);
+                    current = 1 - current;
                 }
+                if (count < 3)
+                    return;
+
+                ScreenVertex<S> v[3 + CLIP_PLANES];
+                for (int i = 0; i < count; i++)
+                    v[i] = project(polygon[current][i]);
+                for (int i = 1; i + 1 < count; i++)
+                    fill_triangle(v[0], v[i], v[i + 1], color);
+            }
+
+            // Liang-Barsky against the planes of mask, in camera space
+            void draw_clipped_line( const Vec3 & a, const Vec3 & b, uint8_t mask, const minwin::Color & color ) {
+                S t0 = 0;
+                S t1 = 1;
+                for (int k = 0; k < CLIP_PLANES; k++) {
+                    if (!(mask & (1 << k)))
+                        continue;
+                    S da = plane_distance(k, a);
+                    S db = plane_distance(k, b);
+                    if (da < 0 && db < 0)
+                        return;
+                    if (da < 0)
+                        t0 = std::max(t0, da / (da - db));
+                    else if (db < 0)
+                        t1 = std::min(t1, da / (da - db));
+                }
+                if (t0 > t1)
+                    return;
+                Vec3 p0 = t0 > 0 ? Vec3(a + (b - a) * t0) : a;
+                Vec3 p1 = t1 < 1 ? Vec3(a + (b - a) * t1) : b;
+                draw_line(project(p0), project(p1), color);
             }
 
-            Vec2r perspective_projection( const Vec4r & v, real d ) {
-                Vec2r result;
+            // (x, y) on the viewport and 1/z for the depth test
+            Vec3 perspective_projection( const Vec4 & v, S d ) {
+                Vec3 result;
                 if (v[2] == 0) {
                     result[0] = 0;
                     result[1] = 0;
+                    result[2] = 0;
                     return result;
                 }
                 result[0] = (d * v[0]) / v[2];
                 result[1] = (d * v[1]) / v[2];
+                result[2] = 1 / v[2];
                 return result;
             }
 
-            void load_obj_file(const char * file_name) {
+            // camera space depth of the object origin, used to draw front to back
+            real view_depth( const Object & o ) const {
+                return o.model_view(camera.transform(), camera.get_version())[2][3];
+            }
 
-                std::ifstream objFile(file_name);
-                if (!objFile.is_open()) {
-                    throw std::invalid_argument("can't open OBJ file");
-                }
+            // matrices rebuilt so far by the camera and the objects
+            unsigned long matrix_rebuilds() const {
+                unsigned long rebuilds = camera.get_rebuilds();
+                for (const Object & o : objects)
+                    rebuilds += o.get_rebuilds();
+                return rebuilds;
+            }
 
-                std::vector<Vertex> vertices;
-                std::vector<Face> faces;
-                std::string line;
-                uint v1;
-                uint v2;
-                uint v3;
-                real x;
-                real y;
-                real z;
-                while (std::getline(objFile, line)) {
-                    std::istringstream lineStream(line);
-                    std::string type;
-                    lineStream >> type;
-                    if (type == "v") {
-                        lineStream >> x >> y >> z;
-                        Vec3r vec {x, y, z};
-                        Vertex v(vec, 1);
-                        vertices.push_back(v);
-                    } else if (type == "f") {
-                        lineStream >> v1 >> v2 >> v3;
-                        v1--;
-                        v2--;
-                        v3--;
-                        Face f(v1, v2, v3, minwin::WHITE);
-                        faces.push_back(f);
-                    }
+            void add_shape(std::unique_ptr<Shape> shape) {
+                shapes.push_back(std::move(shape));
+                Object o(*shapes.back(), {40, 0, 3000}, {0, 0, 0}, {1, 1, 1});
+                add_object(o);
+            }
+
+            // adds the objects of the files loaded since the last frame, or
+            // of all the files still loading when wait is true; the error of
+            // a file that failed is rethrown
+            void receive_shapes(bool wait) {
+                LoadedShape item;
+                while (pending > 0 && (wait ? (item = loaded.pop(), true) : loaded.try_pop(item))) {
+                    pending--;
+                    if (item.error)
+                        std::rethrow_exception(item.error);
+                    add_shape(std::move(item.shape));
+                    if (pending == 0)
+                        std::cout << "objects loaded" << std::endl;
                 }
-                Shape *s = new Shape(file_name, vertices, faces);
-                Object o(*s, {40, 0, 3000}, {0, 0, 0}, {1, 1, 1});
-                Object o_copy(o);
-                add_object(o_copy);
+            }
+
+            void join_loaders() {
+                for (std::thread & loader : loaders)
+                    loader.join();
+                loaders.clear();
             }
 
             void unload_data() {
-                // free objects shapes
+                join_loaders();
+                objects.clear();
+                shapes.clear();
             }
 
         public:
-            Scene() {
+            BasicScene() {
                 objects = std::vector<Object>();
+                projection = {
+                    {VIEWPORT_DISTANCE * CANVAS_WIDTH / VIEWPORT_WIDTH, 0, CANVAS_WIDTH / 2, 0},
+                    {0, -VIEWPORT_DISTANCE * CANVAS_HEIGHT / ((CANVAS_HEIGHT / CANVAS_WIDTH) * VIEWPORT_WIDTH), CANVAS_HEIGHT / 2, 0},
+                    {0, 0, 0, 1},
+                    {0, 0, 1, 0}
+                };
+                set_clip_planes();
+            }
+
+            ~BasicScene() {
+                join_loaders();
             }
 
             void add_object( const Object & o) {
@@ -115,30 +387,56 @@ namespace aline {
             }
 
             void initialise() {
-                window.set_title("Rasterizer");
-                window.set_width(1366);
-                window.set_height(768);
+                target.reset(new WindowTarget("Rasterizer", 1366, 768));
+                wait_for_files = false;
+                framebuffer.resize(target->get_width(), target->get_height());
+                tiler.resize(target->get_width(), target->get_height());
+            }
+
+            // renders frame_count frames without opening a window,
+            // dumping them as PPM files when dump_prefix is not empty
+            void initialise_headless( uint frame_count, const std::string & dump_prefix = "" ) {
+                target.reset(new HeadlessTarget(1366, 768, frame_count, dump_prefix));
+                wait_for_files = true;
+                framebuffer.resize(target->get_width(), target->get_height());
+                tiler.resize(target->get_width(), target->get_height());
+            }
+
+            // blocks until every file given to load_data is loaded and its
+            // object added
+            void finish_loading() {
+                receive_shapes(true);
+            }
+
+            void set_display( int display ) {
+                this->display = display;
+            }
+
+            // 0: scanline, 1: half-space, 2: half-space on multithreaded tiles
+            void set_rasterizer( int rasterizer ) {
+                this->rasterizer = rasterizer;
             }
 
             void run() {
-                window.register_key_behavior(minwin::KEY_ESCAPE, new QuitKeyBehavior(*this));
-                window.register_key_behavior(minwin::KEY_SPACE, new ChangeDisplayBehavior(*this));
-                window.register_key_behavior(minwin::KEY_Z, new MoveForwardBehavior(*this));
-                window.register_key_behavior(minwin::KEY_S, new MoveBackwardBehavior(*this));
-                window.register_key_behavior(minwin::KEY_D, new MoveRightBehavior(*this));
-                window.register_key_behavior(minwin::KEY_Q, new MoveLeftBehavior(*this));
-                window.register_key_behavior(minwin::KEY_W, new MoveUpwardBehavior(*this));
-                window.register_key_behavior(minwin::KEY_X, new MoveDownwardBehavior(*this));
-                window.register_key_behavior(minwin::KEY_R, new RotateRightXBehavior(*this));
-                window.register_key_behavior(minwin::KEY_T, new RotateLeftXBehavior(*this));
-                window.register_key_behavior(minwin::KEY_E, new RotateRightYBehavior(*this));
-                window.register_key_behavior(minwin::KEY_A, new RotateLeftYBehavior(*this));
-                window.register_key_behavior(minwin::KEY_F, new RotateRightZBehavior(*this));
-                window.register_key_behavior(minwin::KEY_G, new RotateLeftZBehavior(*this));
-                window.register_quit_behavior(new QuitButtonBehavior(*this));
+                target->register_key_behavior(minwin::KEY_ESCAPE, new QuitKeyBehavior(*this));
+                target->register_key_behavior(minwin::KEY_SPACE, new ChangeDisplayBehavior(*this));
+                target->register_key_behavior(minwin::KEY_H, new ChangeRasterizerBehavior(*this));
+                target->register_key_behavior(minwin::KEY_Z, new MoveForwardBehavior(*this));
+                target->register_key_behavior(minwin::KEY_S, new MoveBackwardBehavior(*this));
+                target->register_key_behavior(minwin::KEY_D, new MoveRightBehavior(*this));
+                target->register_key_behavior(minwin::KEY_Q, new MoveLeftBehavior(*this));
+                target->register_key_behavior(minwin::KEY_W, new MoveUpwardBehavior(*this));
+                target->register_key_behavior(minwin::KEY_X, new MoveDownwardBehavior(*this));
+                target->register_key_behavior(minwin::KEY_R, new RotateRightXBehavior(*this));
+                target->register_key_behavior(minwin::KEY_T, new RotateLeftXBehavior(*this));
+                target->register_key_behavior(minwin::KEY_E, new RotateRightYBehavior(*this));
+                target->register_key_behavior(minwin::KEY_A, new RotateLeftYBehavior(*this));
+                target->register_key_behavior(minwin::KEY_F, new RotateRightZBehavior(*this));
+                target->register_key_behavior(minwin::KEY_G, new RotateLeftZBehavior(*this));
+                target->register_quit_behavior(new QuitButtonBehavior(*this));
 
                 // open window
-                if( not window.open() )
+                if( not target->open() )
                 {
                     std::cerr << "Couldn't open window.\n";
                     return;
@@ -147,41 +445,92 @@ namespace aline {
                 while( this->running )
                 {
                     // process keyboard inputs, etc.
-                    window.process_input();
+                    target->process_input();
+                    if (not this->running)
+                        break;
+
+                    receive_shapes(wait_for_files);
+
+                    unsigned long allocations = memory::allocation_count();
+                    unsigned long rebuilds = matrix_rebuilds();
+                    arena.reset();
 
                     this->camera.update();
+                    // one pixel of margin for the truncation of to_screen
+                    this->camera.update_frustum(projection, -1, -1, framebuffer.get_width(), framebuffer.get_height());
                     
-                    // clear window
-                    window.clear();
-                    
-                    for (Object o : objects) {
-                        draw_object(o);
+                    framebuffer.clear();
+                    stats.vertices_transformed = 0;
+                    stats.triangles_clipped = 0;
+                    stats.triangles_culled = 0;
+
+                    // objects outside the view volume are skipped before any
+                    // vertex work, the others are drawn front to back so that
+                    // the depth test rejects as much as possible
+                    stats.objects_visible = 0;
+                    stats.objects_culled = 0;
+                    draw_order.clear();
+                    for (size_t i = 0; i < objects.size(); i++) {
+                        if (!camera.get_frustum().intersects(objects[i].get_shape().get_bounds(), objects[i].transform())) {
+                            stats.objects_culled++;
+                            continue;
+                        }
+                        stats.objects_visible++;
+                        draw_order.push_back(std::make_pair(view_depth(objects[i]), i));
                     }
+                    std::sort(draw_order.begin(), draw_order.end());
+
+                    for (const std::pair<real, size_t> & d : draw_order) {
+                        draw_object(objects[d.second]);
+                    }
+
+                    if (display == 1 && rasterizer == 2)
+                        flush_tiles();
+
+                    stats.allocations = memory::allocation_count() - allocations;
+                    stats.matrix_rebuilds = matrix_rebuilds() - rebuilds;
                     
-                    // display elements drawn so far
-                    window.display();
+                    // upload the frame and display it
+                    target->present(framebuffer);
                 }
             }
 
+            const FrameStats & get_stats() const {
+                return stats;
+            }
+
+            const Mat44r & get_projection() const {
+                return projection;
+            }
+
+            const BasicFramebuffer<S> & get_framebuffer() const {
+                return framebuffer;
+            }
+
             void shutdown() {
                 unload_data();
-                window.close();
+                target->close();
             }
 
-            void draw_wireframe_triangle( const Vec2r & v0, const Vec2r & v1, const Vec2r & v2 ) const {
-                draw_line (v0, v1);
-                draw_line (v1, v2);
-                draw_line (v2, v0);
+            void draw_wireframe_triangle( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const ScreenVertex<S> & v2, const minwin::Color & color ) {
+                draw_line (v0, v1, color);
+                draw_line (v1, v2, color);
+                draw_line (v2, v0, color);
             }   
 
-            void draw_filled_triangle( const Vec2r & v0, const Vec2r & v1, const Vec2r & v2 ) const {
-                Vec2i u = canvas_to_window(viewport_to_canvas(v0));
-                Vec2i v = canvas_to_window(viewport_to_canvas(v1));
-                Vec2i w = canvas_to_window(viewport_to_canvas(v2));
+            // 1/z is affine in screen space and can be interpolated
+            // linearly along the edges and spans
+            void draw_filled_triangle( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const ScreenVertex<S> & v2, const minwin::Color & color ) {
+                Vec2i u = v0.p;
+                Vec2i v = v1.p;
+                Vec2i w = v2.p;
+                S zu = v0.z;
+                S zv = v1.z;
+                S zw = v2.z;
 
-                if(v[1] < u[1]) std::swap(v, u);
-                if(w[1] < u[1]) std::swap(w, u);
-                if(w[1] < v[1]) std::swap(w, v);
+                if(v[1] < u[1]) { std::swap(v, u); std::swap(zv, zu); }
+                if(w[1] < u[1]) { std::swap(w, u); std::swap(zw, zu); }
+                if(w[1] < v[1]) { std::swap(w, v); std::swap(zw, zv); }
 
                 int x0 = u[0];
                 int x1 = v[0];
@@ -190,55 +539,130 @@ namespace aline {
                 int y1 = v[1];
                 int y2 = w[1];
 
-                std::vector<real> x02 = interpolate(y0, x0, y2, x2);
-                std::vector<real> x01 = interpolate(y0, x0, y1, x1);
-                std::vector<real> x12 = interpolate(y1 ,x1 ,y2 ,x2);
-
-                x01. pop_back();
-                std::vector<real> x012(x01);
-                x012.insert(x012.end(), x12.begin(), x12.end());
-
-                int m = floor(x012.size() / 2);
-                std::vector<real> x_left;
-                std::vector<real> x_right;
+                // edge tables, one entry per visible scanline; x012 and z012
+                // hold the short edges 0-1 and 1-2 one after the other, 1-2
+                // overwriting the last entry of 0-1
+                int ys = std::max(y0, 0);
+                int ye = std::min(y2, framebuffer.get_height() - 1);
+                if (ys > ye)
+                    return;
+                int n = ye - ys + 1;
+                S * x02 = arena.allocate<S>(n);
+                S * x012 = arena.allocate<S>(n);
+                S * z02 = arena.allocate<S>(n);
+                S * z012 = arena.allocate<S>(n);
+                interpolate(y0, x0, y2, x2, x02, ys, ye);
+                interpolate(y0, x0, y1, x1, x012, ys, ye);
+                interpolate(y1, x1, y2, x2, x012, ys, ye);
+                interpolate(y0, zu, y2, zw, z02, ys, ye);
+                interpolate(y0, zu, y1, zv, z012, ys, ye);
+                interpolate(y1, zv, y2, zw, z012, ys, ye);
+
+                int m = n / 2;
+                const S * x_left = x012;
+                const S * x_right = x02;
+                const S * z_left = z012;
+                const S * z_right = z02;
                 if(x02[m] < x012[m]) {
-                    x_left = x02;
-                    x_right = x012;
-                } else {
-                    x_left = x012;
-                    x_right = x02;
+                    std::swap(x_left, x_right);
+                    std::swap(z_left, z_right);
                 }
 
-                for(int y = y0; y <= y2; ++y)
-                    for(int x = x_left[y - y0]; x <= x_right [y - y0]; ++x)
-                        window.put_pixel(x, y);
+                for(int y = ys; y <= ye; ++y)
+                    framebuffer.fill_span(y, x_left[y - ys], x_right[y - ys], z_left[y - ys], z_right[y - ys], color);
+            }
+
+            // falls back to the scanline path for triangles outside the guard band
+            void draw_filled_triangle_halfspace( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const ScreenVertex<S> & v2, const minwin::Color & color ) {
+                if (!halfspace::fill_triangle(framebuffer, v0.p, v0.z, v1.p, v1.z, v2.p, v2.z, color))
+                    draw_filled_triangle(v0, v1, v2, color);
             }
 
-            std::vector<real> interpolate (int i0, real d0, int i1, real d1) const {
-                std::vector<real> values;
+            void bin_filled_triangle( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const ScreenVertex<S> & v2, const minwin::Color & color ) {
+                if (tiler.add_triangle(v0.p, v0.z, v1.p, v1.z, v2.p, v2.z, color))
+                    return;
+                deferred.push_back(v0);
+                deferred.push_back(v1);
+                deferred.push_back(v2);
+                deferred_colors.push_back(color);
+            }
+
+            void flush_tiles() {
+                tiler.flush(framebuffer);
+                for (size_t i = 0; i < deferred_colors.size(); i++)
+                    draw_filled_triangle(deferred[3 * i], deferred[3 * i + 1], deferred[3 * i + 2], deferred_colors[i]);
+                deferred.clear();
+                deferred_colors.clear();
+            }
+
+            // writes the values going from d0 at i0 to d1 at i1 into values,
+            // only for i in [lo, hi] and at values[i - lo]
+            int interpolate (int i0, S d0, int i1, S d1, S * values, int lo, int hi) const {
+                int first = std::max(i0, lo);
+                int last = std::min(i1, hi);
+                if (first > last)
+                    return 0;
                 if( i0 == i1 ) {
-                    values.push_back(d0);
-                    return values;
+                    values[i0 - lo] = d0;
+                    return 1;
                 }
             
-                real a = (d0 - d1) / (i0 - i1);
-                real d = d0;
+                S a = (d0 - d1) / (i0 - i1);
+                S d = first == i0 ? d0 : d0 + a * (first - i0);
             
-                for(int i = i0; i <= i1; ++i) {
-                    values.push_back(d);
+                for(int i = first; i <= last; ++i) {
+                    values[i - lo] = d;
                     d = d + a;
                 }
-                return values ;
+                return last - first + 1;
+            }
+
+            // Liang-Barsky against the framebuffer, so that Bresenham never
+            // walks pixels outside of it; false when nothing is left
+            bool clip_to_screen( int & x0, int & y0, int & x1, int & y1 ) const {
+                const int xmax = framebuffer.get_width() - 1;
+                const int ymax = framebuffer.get_height() - 1;
+                if (std::min({x0, x1, y0, y1}) >= 0 && std::max(x0, x1) <= xmax && std::max(y0, y1) <= ymax)
+                    return true;
+                const double dx = x1 - x0;
+                const double dy = y1 - y0;
+                const double p[4] = { -dx, dx, -dy, dy };
+                const double q[4] = { (double) x0, (double) (xmax - x0), (double) y0, (double) (ymax - y0) };
+                double t0 = 0;
+                double t1 = 1;
+                for (int k = 0; k < 4; k++) {
+                    if (p[k] == 0) {
+                        if (q[k] < 0)
+                            return false;
+                        continue;
+                    }
+                    double t = q[k] / p[k];
+                    if (p[k] < 0)
+                        t0 = std::max(t0, t);
+                    else
+                        t1 = std::min(t1, t);
+                }
+                if (t0 > t1)
+                    return false;
+                const int sx = x0;
+                const int sy = y0;
+                x0 = std::clamp((int) std::lround(sx + t0 * dx), 0, xmax);
+                y0 = std::clamp((int) std::lround(sy + t0 * dy), 0, ymax);
+                x1 = std::clamp((int) std::lround(sx + t1 * dx), 0, xmax);
+                y1 = std::clamp((int) std::lround(sy + t1 * dy), 0, ymax);
+                return true;
             }
 
-            void draw_line( const Vec2r & v0, const Vec2r & v1 ) const { 
-                Vec2i u = canvas_to_window(viewport_to_canvas(v0));
-                Vec2i v = canvas_to_window(viewport_to_canvas(v1));
+            void draw_line( const ScreenVertex<S> & v0, const ScreenVertex<S> & v1, const minwin::Color & color ) {
+                const Vec2i & u = v0.p;
+                const Vec2i & v = v1.p;
 
                 int x0 = u[0];
                 int x1 = v[0];
                 int y0 = u[1];
                 int y1 = v[1];
+                if (!clip_to_screen(x0, y0, x1, y1))
+                    return;
 
                 int dx = abs(x1 - x0);
                 int sx = x0 < x1 ? 1 : -1;
@@ -247,7 +671,7 @@ namespace aline {
                 int error = dx + dy;
                 
                 while (true) {
-                    window.put_pixel(x0, y0);
+                    framebuffer.put_pixel(x0, y0, color);
                     if (x0 == x1 && y0 == y1) break;
                     int e2 = 2 * error;
                     if (e2 >= dy) {
@@ -270,22 +694,37 @@ namespace aline {
 
                 std::cout << "loading objects..." << std::endl;
 
+                // one thread per file, each one parsing its file on its
+                // share of the cores, or mapping its up to date mesh cache;
+                // run() adds the objects in the order they are ready
+                const unsigned files = argc - 1;
+                const unsigned threads = std::max(1u, std::thread::hardware_concurrency() / files);
+                pending += files;
                 for (int i = 1; i < argc; i++) {
-                    char* filename = argv[i];
-                    load_obj_file(filename);
+                    loaders.emplace_back([this, file_name = std::string(argv[i]), threads]() {
+                        LoadedShape item;
+                        try {
+                            item.shape = std::make_unique<Shape>(load_mesh(file_name.c_str(), threads));
+                        } catch (...) {
+                            item.error = std::current_exception();
+                        }
+                        loaded.push(std::move(item));
+                    });
                 }
-
-                std::cout << "objects loaded" << std::endl;
             }
                         
-            Vec2r viewport_to_canvas( const Vec2r & point ) const {
-                Vec2r vec = Vec2r();
+            Vec2 viewport_to_canvas( const Vec2 & point ) const {
+                Vec2 vec = Vec2();
                 vec[0] = point[0] * CANVAS_WIDTH / VIEWPORT_WIDTH;
                 vec[1] = point[1] * CANVAS_HEIGHT / ((CANVAS_HEIGHT/CANVAS_WIDTH) * VIEWPORT_WIDTH);
                 return vec;
             }
 
-            Vec2i canvas_to_window( const Vec2r & point ) const {
+            ScreenVertex<S> to_screen( const Vec3 & point ) const {
+                return ScreenVertex<S> { canvas_to_window(viewport_to_canvas(Vec2 {point[0], point[1]})), point[2] };
+            }
+
+            Vec2i canvas_to_window( const Vec2 & point ) const {
                 Vec2i vec = Vec2i();
                 vec[0] = CANVAS_WIDTH/2 + point[0];
                 vec[1] = CANVAS_HEIGHT/2 - point[1];
@@ -295,26 +734,26 @@ namespace aline {
             class QuitButtonBehavior : public minwin::IButtonBehavior
             {
                 public:
-                    QuitButtonBehavior(Scene &scene): owner {scene} {}
+                    QuitButtonBehavior(BasicScene &scene): owner {scene} {}
                     void on_click() const { this->owner.running = false; }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class QuitKeyBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    QuitKeyBehavior(Scene & scene): owner {scene} {}
+                    QuitKeyBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const { this->owner.running = false; }
                     void on_release() const {}
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class ChangeDisplayBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    ChangeDisplayBehavior(Scene & scene): owner {scene} {}
+                    ChangeDisplayBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         if (this->owner.display == 0) {
                             this->owner.display = 1;
@@ -325,13 +764,25 @@ namespace aline {
                     }
                     void on_release() const {}
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
+            };
+
+            class ChangeRasterizerBehavior : public minwin::IKeyBehavior
+            {
+                public:
+                    ChangeRasterizerBehavior(BasicScene & scene): owner {scene} {}
+                    void on_press() const {
+                        this->owner.rasterizer = (this->owner.rasterizer + 1) % 3;
+                    }
+                    void on_release() const {}
+                private:
+                    BasicScene & owner;
             };
 
             class MoveForwardBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveForwardBehavior(Scene & scene): owner {scene} {}
+                    MoveForwardBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_forward(2);
                     }
@@ -339,13 +790,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class MoveBackwardBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveBackwardBehavior(Scene & scene): owner {scene} {}
+                    MoveBackwardBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_backward(2);
                     }
@@ -353,13 +804,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class MoveUpwardBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveUpwardBehavior(Scene & scene): owner {scene} {}
+                    MoveUpwardBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_forward(1);
                     }
@@ -367,13 +818,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class MoveDownwardBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveDownwardBehavior(Scene & scene): owner {scene} {}
+                    MoveDownwardBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_backward(1);
                     }
@@ -381,13 +832,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class MoveRightBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveRightBehavior(Scene & scene): owner {scene} {}
+                    MoveRightBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_forward(0);
                     }
@@ -395,13 +846,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class MoveLeftBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    MoveLeftBehavior(Scene & scene): owner {scene} {}
+                    MoveLeftBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.move_backward(0);
                     }
@@ -409,13 +860,13 @@ namespace aline {
                         this->owner.camera.stop_movement();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateLeftXBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateLeftXBehavior(Scene & scene): owner {scene} {}
+                    RotateLeftXBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_acw(0);
                     }
@@ -423,13 +874,13 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateRightXBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateRightXBehavior(Scene & scene): owner {scene} {}
+                    RotateRightXBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_cw(0);
                     }
@@ -437,13 +888,13 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateLeftYBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateLeftYBehavior(Scene & scene): owner {scene} {}
+                    RotateLeftYBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_acw(1);
                     }
@@ -451,13 +902,13 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateRightYBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateRightYBehavior(Scene & scene): owner {scene} {}
+                    RotateRightYBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_cw(1);
                     }
@@ -465,13 +916,13 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateLeftZBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateLeftZBehavior(Scene & scene): owner {scene} {}
+                    RotateLeftZBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_acw(2);
                     }
@@ -479,13 +930,13 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
 
             class RotateRightZBehavior : public minwin::IKeyBehavior
             {
                 public:
-                    RotateRightZBehavior(Scene & scene): owner {scene} {}
+                    RotateRightZBehavior(BasicScene & scene): owner {scene} {}
                     void on_press() const {
                         this->owner.camera.rotate_cw(2);
                     }
@@ -493,7 +944,12 @@ namespace aline {
                         this->owner.camera.stop_rotation();
                     }
                 private:
-                    Scene & owner;
+                    BasicScene & owner;
             };
     };
+
+    // float is precise enough for the pipeline, see test_precision
+    using Scene = BasicScene<float>;
 }
+
+#endif // _ALINE_SCENE_H_
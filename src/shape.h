@@ -1,4 +1,16 @@
+#ifndef _ALINE_SHAPE_H_
+#define _ALINE_SHAPE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
 #include "matrix.h"
+#include "quaternion.h"
+#include "view.h"
+#include "aligned.h"
 #include "color.h"
 
 namespace aline {
@@ -13,7 +25,7 @@ namespace aline {
                 this->h = h;
             }
 
-            Vec3r get_vector() const {
+            const Vec3r & get_vector() const {
                 return vec;
             }
 
@@ -53,68 +65,288 @@ namespace aline {
             }
     };
 
+    // axis-aligned box and bounding sphere of a shape, in object space
+    struct Bounds {
+        Vec3r min;
+        Vec3r max;
+        Vec3r center;
+        real radius = 0;
+    };
+
+    // streams a Shape can be built from and own; the normal and texture
+    // coordinate streams are either empty or one element per vertex
+    struct MeshStreams {
+        AlignedVector<float> xs;
+        AlignedVector<float> ys;
+        AlignedVector<float> zs;
+        AlignedVector<float> nxs;
+        AlignedVector<float> nys;
+        AlignedVector<float> nzs;
+        AlignedVector<float> us;
+        AlignedVector<float> vs;
+        AlignedVector<uint> indices;
+        std::vector<minwin::Color> colors;
+    };
+
+    // optional per vertex streams of a Shape: normal and texture coordinates
+    struct VertexAttributes {
+        View<float> nx;
+        View<float> ny;
+        View<float> nz;
+        View<float> u;
+        View<float> v;
+    };
+
+    // mesh stored as streams: aligned x, y and z coordinate arrays, a packed
+    // index buffer with three indices per triangle and one color per face,
+    // so that transform and culling kernels can run over them with unit
+    // stride; Vertex and Face are built on demand as views of one element.
+    // The streams are never modified: they live in a storage shared by the
+    // copies of the shape, either vectors it owns or a mapped mesh file
     class Shape {
         private:
             std::string name;
-            std::vector<Vertex> vertices;
-            std::vector<Face> faces;
+            std::shared_ptr<const void> storage;
+            View<float> xs;
+            View<float> ys;
+            View<float> zs;
+            View<uint> indices;
+            View<minwin::Color> colors;
+            VertexAttributes attributes;
+            Bounds bounds;
+
+            void check_sizes() const {
+                if (ys.size() != xs.size() || zs.size() != xs.size() || indices.size() != 3 * colors.size())
+                    throw std::invalid_argument("Shape: streams of different sizes");
+                if (attributes.ny.size() != attributes.nx.size() || attributes.nz.size() != attributes.nx.size()
+                    || (!attributes.nx.empty() && attributes.nx.size() != xs.size()))
+                    throw std::invalid_argument("Shape: normals of different sizes");
+                if (attributes.v.size() != attributes.u.size() || (!attributes.u.empty() && attributes.u.size() != xs.size()))
+                    throw std::invalid_argument("Shape: texture coordinates of different sizes");
+            }
+
+            void adopt( std::shared_ptr<MeshStreams> streams ) {
+                xs = View<float>(streams->xs);
+                ys = View<float>(streams->ys);
+                zs = View<float>(streams->zs);
+                attributes.nx = View<float>(streams->nxs);
+                attributes.ny = View<float>(streams->nys);
+                attributes.nz = View<float>(streams->nzs);
+                attributes.u = View<float>(streams->us);
+                attributes.v = View<float>(streams->vs);
+                indices = View<uint>(streams->indices);
+                colors = View<minwin::Color>(streams->colors);
+                storage = std::move(streams);
+                check_sizes();
+                compute_bounds();
+            }
+
+            // the sphere is centered on the box, its radius reaches the
+            // farthest vertex
+            void compute_bounds() {
+                if (xs.empty())
+                    return;
+                bounds.min = {xs[0], ys[0], zs[0]};
+                bounds.max = bounds.min;
+                for (size_t i = 1; i < xs.size(); i++) {
+                    bounds.min = {std::min<real>(bounds.min[0], xs[i]), std::min<real>(bounds.min[1], ys[i]), std::min<real>(bounds.min[2], zs[i])};
+                    bounds.max = {std::max<real>(bounds.max[0], xs[i]), std::max<real>(bounds.max[1], ys[i]), std::max<real>(bounds.max[2], zs[i])};
+                }
+                bounds.center = (bounds.min + bounds.max) / 2.0;
+                real sq_radius = 0;
+                for (size_t i = 0; i < xs.size(); i++)
+                    sq_radius = std::max(sq_radius, sq_norm(Vec3r {xs[i], ys[i], zs[i]} - bounds.center));
+                bounds.radius = std::sqrt(sq_radius);
+            }
         public:
             Shape( const std::string & name, const std::vector<Vertex> & vertices, const std::vector<Face> & faces ) {
                 this->name = name;
-                this->vertices = vertices;
-                this->faces = faces;
+                std::shared_ptr<MeshStreams> streams = std::make_shared<MeshStreams>();
+                streams->xs.reserve(vertices.size());
+                streams->ys.reserve(vertices.size());
+                streams->zs.reserve(vertices.size());
+                for (const Vertex & v : vertices) {
+                    streams->xs.push_back(v.get_vector()[0]);
+                    streams->ys.push_back(v.get_vector()[1]);
+                    streams->zs.push_back(v.get_vector()[2]);
+                }
+                streams->indices.reserve(3 * faces.size());
+                streams->colors.reserve(faces.size());
+                for (const Face & f : faces) {
+                    streams->indices.push_back(f.get_v0());
+                    streams->indices.push_back(f.get_v1());
+                    streams->indices.push_back(f.get_v2());
+                    streams->colors.push_back(f.get_color());
+                }
+                adopt(std::move(streams));
             }
 
-            std::string get_name() const {
+            Shape( const std::string & name, AlignedVector<float> && xs, AlignedVector<float> && ys, AlignedVector<float> && zs,
+                   AlignedVector<uint> && indices, std::vector<minwin::Color> && colors ) {
+                this->name = name;
+                std::shared_ptr<MeshStreams> streams = std::make_shared<MeshStreams>();
+                streams->xs = std::move(xs);
+                streams->ys = std::move(ys);
+                streams->zs = std::move(zs);
+                streams->indices = std::move(indices);
+                streams->colors = std::move(colors);
+                adopt(std::move(streams));
+            }
+
+            Shape( const std::string & name, MeshStreams && streams ) {
+                this->name = name;
+                adopt(std::make_shared<MeshStreams>(std::move(streams)));
+            }
+
+            // streams kept alive by storage, used in place without a copy,
+            // and their precomputed bounds
+            Shape( const std::string & name, View<float> xs, View<float> ys, View<float> zs, View<uint> indices,
+                   View<minwin::Color> colors, const Bounds & bounds, std::shared_ptr<const void> storage,
+                   const VertexAttributes & attributes = VertexAttributes() ) {
+                this->name = name;
+                this->xs = xs;
+                this->ys = ys;
+                this->zs = zs;
+                this->indices = indices;
+                this->colors = colors;
+                this->bounds = bounds;
+                this->storage = std::move(storage);
+                this->attributes = attributes;
+                check_sizes();
+            }
+
+            const std::string & get_name() const {
                 return name;
             }
 
-            std::vector<Vertex> get_vertices() const {
-                return vertices;
+            const Bounds & get_bounds() const {
+                return bounds;
+            }
+
+            size_t vertex_count() const {
+                return xs.size();
             }
 
-            std::vector<Face> get_faces() const {
-                return faces;
+            size_t face_count() const {
+                return colors.size();
+            }
+
+            Vertex get_vertex( size_t i ) const {
+                return Vertex({xs[i], ys[i], zs[i]}, 1);
+            }
+
+            Face get_face( size_t i ) const {
+                return Face(indices[3 * i], indices[3 * i + 1], indices[3 * i + 2], colors[i]);
+            }
+
+            View<float> get_x() const {
+                return xs;
+            }
+
+            View<float> get_y() const {
+                return ys;
+            }
+
+            View<float> get_z() const {
+                return zs;
+            }
+
+            View<uint> get_indices() const {
+                return indices;
+            }
+
+            View<minwin::Color> get_colors() const {
+                return colors;
+            }
+
+            const VertexAttributes & get_attributes() const {
+                return attributes;
+            }
+
+            bool has_normals() const {
+                return !attributes.nx.empty();
+            }
+
+            bool has_uvs() const {
+                return !attributes.u.empty();
             }
     };
 
+    // which triangles of an object are skipped: those facing away from the
+    // camera, those facing it, or none
+    enum class CullMode { Back, Front, None };
+
     class Object {
         private:
             const Shape * shape;
+            CullMode cull_mode;
             Vec3r translation;
-            Vec3r rotation;
+            Quatr rotation;
             Vec3r scale;
+            // transform() and model_view() are rebuilt on first use after a
+            // change, model_view also when the camera version moves on
+            mutable Mat44r model;
+            mutable bool model_dirty;
+            mutable Mat44r view_model;
+            mutable unsigned long view_version;
+            mutable unsigned long rebuilds;
+
+            void invalidate() {
+                model_dirty = true;
+                view_version = 0;
+            }
         public:
+            // rotation holds Euler angles in degrees
             Object(const Shape & shape, const Vec3r & translation, const Vec3r & rotation, const Vec3r & scale) {
                 this->shape = &shape;
                 this->translation = translation;
+                this->rotation = from_euler(Vec3r(rotation * (M_PI / 180)));
+                this->scale = scale;
+                cull_mode = CullMode::Back;
+                rebuilds = 0;
+                invalidate();
+            }
+
+            const Vec3r & get_translation() const {
+                return translation;
+            }
+
+            void set_translation(const Vec3r & translation) {
+                this->translation = translation;
+                invalidate();
+            }
+
+            const Quatr & get_rotation() const {
+                return rotation;
+            }
+
+            void set_rotation(const Quatr & rotation) {
                 this->rotation = rotation;
+                invalidate();
+            }
+
+            const Vec3r & get_scale() const {
+                return scale;
+            }
+
+            void set_scale(const Vec3r & scale) {
                 this->scale = scale;
+                invalidate();
             }
 
-            Mat44r transform() const {
-                Mat44r transformMatrix = 
-                {
-                    {1, 0, 0, 0},
-                    {0, 1, 0, 0},
-                    {0, 0, 1, 0},
-                    {0, 0, 0, 1}
-                };
-                Mat44r rotationMatrix;
+            // applies step after the current rotation
+            void rotate(const Quatr & step) {
+                rotation = unit_quaternion(step * rotation);
+                invalidate();
+            }
+
+            const Mat44r & transform() const {
+                if (!model_dirty)
+                    return model;
+                Mat44r rotationMatrix = to_matrix(rotation);
                 Mat44r scaleMatrix;
                 Mat44r translationMatrix;
 
-                real r0 = rotation[0] * M_PI / 180;
-                real r1 = rotation[1] * M_PI / 180;
-                real r2 = rotation[2] * M_PI / 180;
-
-                rotationMatrix = {
-                    {cos(r1) * cos(r2), cos(r1) * sin(r2), -sin(r1), 0},
-                    {sin(r0) * sin(r1) * cos(r2) - cos(r0) * sin(r2), sin(r0) * sin(r1) * sin(r2) + cos(r0) * cos(r2), sin(r0) * cos(r1), 0},
-                    {cos(r0) * sin(r1) * cos(r2) + sin(r0) * sin(r2), cos(r0) * sin(r1) * sin(r2) - sin(r0) * cos(r2), cos(r0) * cos(r1), 0},
-                    {0, 0, 0, 1}
-                };
-
                 translationMatrix = {
                     {1, 0, 0, translation[0]},
                     {0, 1, 0, translation[1]},
@@ -130,43 +362,122 @@ namespace aline {
                 };
 
                 // SRT
-                // transformMatrix = scaleMatrix * rotationMatrix * translationMatrix;
+                // model = scaleMatrix * rotationMatrix * translationMatrix;
 
                 // TRS
-                transformMatrix = translationMatrix * rotationMatrix * scaleMatrix;
+                model = translationMatrix * rotationMatrix * scaleMatrix;
+                model_dirty = false;
+                rebuilds++;
+                return model;
+            }
+
+            // view * transform(), view being the camera transform of the
+            // given version (see Camera::get_version)
+            const Mat44r & model_view(const Mat44r & view, unsigned long version) const {
+                if (view_version == version)
+                    return view_model;
+                view_model = view * transform();
+                view_version = version;
+                rebuilds++;
+                return view_model;
+            }
+
+            CullMode get_cull_mode() const {
+                return cull_mode;
+            }
 
-                return transformMatrix;
+            void set_cull_mode(CullMode cull_mode) {
+                this->cull_mode = cull_mode;
             }
 
-            std::vector<Vertex> get_vertices() const {
-                return shape->get_vertices();
+            // matrices rebuilt so far, by transform() and model_view()
+            unsigned long get_rebuilds() const {
+                return rebuilds;
             }
 
-            std::vector<Face> get_faces() const {
-                return shape->get_faces();
+            const Shape & get_shape() const {
+                return *shape;
             }
     };
 
+    // planes (a, b, c, d) of the view volume in world space, a point p is
+    // inside a plane when a * p.x + b * p.y + c * p.z + d >= 0
     class Frustum {
         private:
+            real near_dist;
+            real far_dist;
             Vec4r near; // front
             Vec4r far; // back
             Vec4r right;
             Vec4r left;
             Vec4r bottom;
             Vec4r top;
+
+            // plane p seen from the space that model maps to world space
+            static Vec4r to_object(const Vec4r & p, const Mat44r & model) {
+                Vec4r q;
+                for (int j = 0; j < 4; j++)
+                    q[j] = p[0] * model[0][j] + p[1] * model[1][j] + p[2] * model[2][j] + p[3] * model[3][j];
+                return q;
+            }
+
+            static bool outside(const Vec4r & p, const Bounds & b) {
+                real n = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                if (p[0] * b.center[0] + p[1] * b.center[1] + p[2] * b.center[2] + p[3] < -b.radius * n)
+                    return true;
+                // corner of the box farthest along the plane normal
+                real x = p[0] >= 0 ? b.max[0] : b.min[0];
+                real y = p[1] >= 0 ? b.max[1] : b.min[1];
+                real z = p[2] >= 0 ? b.max[2] : b.min[2];
+                return p[0] * x + p[1] * y + p[2] * z + p[3] < 0;
+            }
         public:
+            // distances along the camera z axis, in world units; until the
+            // first update() the planes are those of an identity view
+            // without side planes
             Frustum(real near_dist, real far_dist) {
-                near = {0, 0, -1, -near_dist};
-                far = {0, 0, 1, far_dist};
-                left = {2, 0, -1, 0};
-                right = {-2, 0, -1, 0};
-                bottom = {0, 2, -1, 0};
-                top = {0, -2, -1, 0};
+                this->near_dist = near_dist;
+                this->far_dist = far_dist;
+                near = {0, 0, 1, -near_dist};
+                far = {0, 0, -1, far_dist};
+                left = {0, 0, 0, 1};
+                right = {0, 0, 0, 1};
+                bottom = {0, 0, 0, 1};
+                top = {0, 0, 0, 1};
+            }
+
+            real get_near_distance() const {
+                return near_dist;
+            }
+
+            real get_far_distance() const {
+                return far_dist;
+            }
+
+            // planes of view_projection (world to homogeneous window
+            // coordinates, w being the camera space z) for the window
+            // rectangle [x0, x1] x [y0, y1]
+            void update(const Mat44r & view_projection, real x0, real y0, real x1, real y1) {
+                const Vec4r & rx = view_projection[0];
+                const Vec4r & ry = view_projection[1];
+                const Vec4r & rw = view_projection[3];
+                left = rx - x0 * rw;
+                right = x1 * rw - rx;
+                top = ry - y0 * rw;
+                bottom = y1 * rw - ry;
+                near = rw - Vec4r {0, 0, 0, near_dist};
+                far = Vec4r {0, 0, 0, far_dist} - rw;
             }
 
-            Object clip(const Object &obj) const {
-                return obj;
+            // false when b, placed in the world by model, is entirely
+            // outside one of the planes; planes are brought to object space
+            // so that the box stays axis-aligned
+            bool intersects(const Bounds & b, const Mat44r & model) const {
+                const Vec4r * planes[6] = { &near, &left, &right, &top, &bottom, &far };
+                for (const Vec4r * p : planes)
+                    if (outside(to_object(*p, model), b))
+                        return false;
+                return true;
             }
     };
 
@@ -175,8 +486,8 @@ namespace aline {
             real aspect_ratio;
             real focal_dist;
             Vec4r position;
-            Frustum frustum = Frustum(0.1, 5.0);
-            Vec3r orientation;
+            Frustum frustum = Frustum(1, 100000);
+            Quatr orientation;
             real move_speed;
             real rot_speed;
             real zoom_speed;
@@ -185,18 +496,44 @@ namespace aline {
             real current_zoom_speed;
             uint axis;
             uint axisR;
+            // rot_speed degrees around each axis, computed once so that
+            // update() has no trigonometry to do
+            Quatr rotation_steps[3];
+            Quatr current_rotation;
+            // transform() is rebuilt on first use after a change, version
+            // counts the changes so that objects can tell a stale model_view
+            mutable Mat44r view;
+            mutable bool view_dirty;
+            unsigned long version;
+            mutable unsigned long rebuilds;
+
+            void invalidate() {
+                view_dirty = true;
+                version++;
+            }
         public:
+            // orientation holds Euler angles in degrees
             Camera(real aspect_ratio, real focal_dist = 2, Vec4r position = {0.0, 0.0, 0.0, 1.0}, Vec3r orientation = {0.0, 0.0, 0.0}, real move_speed = 2, real rot_speed = 0.25, real zoom_speed = 0.0625) {
                 this->aspect_ratio = aspect_ratio;
                 this->focal_dist = focal_dist;
                 this->position = position;
-                this->orientation = orientation;
+                this->orientation = from_euler(Vec3r(orientation * (M_PI / 180)));
                 this->move_speed = move_speed;
                 this->rot_speed = rot_speed;
                 this->zoom_speed = zoom_speed;
                 current_move_speed = 0;
                 current_rot_speed = 0;
                 current_zoom_speed = 0;
+                axis = 0;
+                axisR = 0;
+                for (int i = 0; i < 3; i++) {
+                    Vec3r e;
+                    e[i] = 1;
+                    rotation_steps[i] = from_axis_angle(e, -rot_speed * M_PI / 180);
+                }
+                view_dirty = true;
+                version = 1;
+                rebuilds = 0;
             }
 
             void move_forward(uint axis) {
@@ -211,11 +548,13 @@ namespace aline {
 
             void rotate_cw(uint axis) {
                 current_rot_speed = rot_speed;
+                current_rotation = rotation_steps[axis];
                 this->axisR = axis;
             }
 
             void rotate_acw(uint axis) {
                 current_rot_speed = -rot_speed;
+                current_rotation = conjugate(rotation_steps[axis]);
                 this->axisR = axis;
             }
 
@@ -233,35 +572,20 @@ namespace aline {
 
             void stop_rotation() {
                 current_rot_speed = 0;
+                current_rotation = Quatr();
             }
 
             void stop_zoom() {
                 current_zoom_speed = 0;
             }
 
-            Mat44r transform() const {
-                Mat44r transformMatrix = 
-                {
-                    {1, 0, 0, 0},
-                    {0, 1, 0, 0},
-                    {0, 0, 1, 0},
-                    {0, 0, 0, 1}
-                };
-                Mat44r rotationMatrix;
+            const Mat44r & transform() const {
+                if (!view_dirty)
+                    return view;
+                Mat44r rotationMatrix = to_matrix(orientation);
                 Mat44r scaleMatrix;
                 Mat44r translationMatrix;
 
-                real r0 = orientation[0] * M_PI / 180;
-                real r1 = orientation[1] * M_PI / 180;
-                real r2 = orientation[2] * M_PI / 180;
-
-                rotationMatrix = {
-                    {cos(r1) * cos(r2), cos(r1) * sin(r2), -sin(r1), 0},
-                    {sin(r0) * sin(r1) * cos(r2) - cos(r0) * sin(r2), sin(r0) * sin(r1) * sin(r2) + cos(r0) * cos(r2), sin(r0) * cos(r1), 0},
-                    {cos(r0) * sin(r1) * cos(r2) + sin(r0) * sin(r2), cos(r0) * sin(r1) * sin(r2) - sin(r0) * cos(r2), cos(r0) * cos(r1), 0},
-                    {0, 0, 0, 1}
-                };
-
                 translationMatrix = {
                     {1, 0, 0, -position[0]},
                     {0, 1, 0, -position[1]},
@@ -277,24 +601,54 @@ namespace aline {
                 };
 
                 // SRT
-                // transformMatrix = scaleMatrix * rotationMatrix * translationMatrix;
+                // view = scaleMatrix * rotationMatrix * translationMatrix;
 
                 // TRS
-                transformMatrix = translationMatrix * rotationMatrix * scaleMatrix;
+                view = translationMatrix * rotationMatrix * scaleMatrix;
+                view_dirty = false;
+                rebuilds++;
+                return view;
+            }
+
+            // starts at 1 and changes with every change of transform()
+            unsigned long get_version() const {
+                return version;
+            }
+
+            // matrices rebuilt so far by transform()
+            unsigned long get_rebuilds() const {
+                return rebuilds;
+            }
+
+            const Frustum & get_frustum() const {
+                return frustum;
+            }
 
-                return transformMatrix;
+            // projection maps camera space to homogeneous window coordinates,
+            // the window being [x0, x1] x [y0, y1]
+            void update_frustum(const Mat44r & projection, real x0, real y0, real x1, real y1) {
+                frustum.update(projection * transform(), x0, y0, x1, y1);
+            }
+
+            // camera to world, for picking and unprojection
+            Mat44r inverse_transform() const {
+                return affine_inverse(transform());
             }
 
             void update() {
+                if (current_move_speed == 0 && current_rot_speed == 0)
+                    return;
+                invalidate();
                 position[axis] += current_move_speed;
-                // Vec3r a = {0, 0, 0};
-                // a[axis] += current_rot_speed;
-                // Vec3r tmp =  a * sin(current_rot_speed / 2 );
-                // Vec4r r = {tmp[0], tmp[1], tmp[2], cos(current_rot_speed / 2)};
-                orientation[axisR] += current_rot_speed;
+                // the step turns around the camera's own axes, so no
+                // combination of the controls can lock one of them
+                if (current_rot_speed != 0)
+                    orientation = unit_quaternion(current_rotation * orientation);
                 // rotating the camera will also move forward this a counter measure to attenuate the zoom
                 if (axisR != 2 && current_move_speed == 0 && current_rot_speed != 0)
                     position[2] -= move_speed + current_rot_speed;
             }
     };
-}
\ No newline at end of file
+}
+
+#endif // _ALINE_SHAPE_H_
@@ -0,0 +1,211 @@
+#ifndef _ALINE_SIMD_H_
+#define _ALINE_SIMD_H_
+
+#include <cmath>
+#include <concepts>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "vector.h"
+#include "matrix.h"
+
+// SSE/AVX versions of the 4-wide float and double kernels. They only take
+// the exact Vector and Matrix types, never an expression to convert, and
+// overload resolution prefers them to the generic templates of vector.h and
+// matrix.h; without the instruction set, and in constant expressions, the
+// templates are used.
+// Results may differ from the templates in the last bits: dot and normalize
+// sum horizontally, and the compiler is free to contract either side into FMAs.
+namespace aline {
+
+#if defined(__SSE2__)
+    namespace simd {
+
+        // columns of the row-major matrix m
+        inline void columns( const Matrix<float, 4, 4> & m, __m128 c[4] ) {
+            c[0] = _mm_load_ps(m[0].data());
+            c[1] = _mm_load_ps(m[1].data());
+            c[2] = _mm_load_ps(m[2].data());
+            c[3] = _mm_load_ps(m[3].data());
+            _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+        }
+
+        inline float horizontal_sum( __m128 p ) {
+            __m128 s = _mm_add_ps(p, _mm_movehl_ps(p, p));
+            s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+            return _mm_cvtss_f32(s);
+        }
+    }
+
+    template <std::same_as<Matrix<float, 4, 4>> A, std::same_as<Vector<float, 4>> B>
+    constexpr Vector<float, 4> operator*( const A & m, const B & v ) {
+        if (std::is_constant_evaluated())
+            return operator*<float, 4, 4>(m, v);
+        __m128 c[4];
+        simd::columns(m, c);
+        const float * x = v.data();
+        __m128 r = _mm_mul_ps(c[0], _mm_set1_ps(x[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(c[1], _mm_set1_ps(x[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c[2], _mm_set1_ps(x[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(c[3], _mm_set1_ps(x[3])));
+        Vector<float, 4> res;
+        _mm_store_ps(res.data(), r);
+        return res;
+    }
+
+    // row i of the product is the rows of n weighted by the elements of row i of m
+    template <std::same_as<Matrix<float, 4, 4>> A, std::same_as<Matrix<float, 4, 4>> B>
+    constexpr Matrix<float, 4, 4> operator*( const A & m, const B & n ) {
+        if (std::is_constant_evaluated())
+            return Matrix<float, 4, 4>(operator*<float, 4, 4, 4>(m, n));
+        __m128 n0 = _mm_load_ps(n[0].data());
+        __m128 n1 = _mm_load_ps(n[1].data());
+        __m128 n2 = _mm_load_ps(n[2].data());
+        __m128 n3 = _mm_load_ps(n[3].data());
+        Matrix<float, 4, 4> res;
+        for (int i = 0; i < 4; i++) {
+            const float * a = m[i].data();
+            __m128 row = _mm_mul_ps(n0, _mm_set1_ps(a[0]));
+            row = _mm_add_ps(row, _mm_mul_ps(n1, _mm_set1_ps(a[1])));
+            row = _mm_add_ps(row, _mm_mul_ps(n2, _mm_set1_ps(a[2])));
+            row = _mm_add_ps(row, _mm_mul_ps(n3, _mm_set1_ps(a[3])));
+            _mm_store_ps(res[i].data(), row);
+        }
+        return res;
+    }
+
+    template <std::same_as<Vector<float, 4>> A, std::same_as<Vector<float, 4>> B>
+    constexpr float dot( const A & u, const B & v ) {
+        if (std::is_constant_evaluated())
+            return dot<float, 4>(u, v);
+        return simd::horizontal_sum(_mm_mul_ps(_mm_load_ps(u.data()), _mm_load_ps(v.data())));
+    }
+
+    // cross product of the first three components, the fourth is 0
+    template <std::same_as<Vector<float, 4>> A, std::same_as<Vector<float, 4>> B>
+    constexpr Vector<float, 4> cross( const A & u, const B & v ) {
+        if (std::is_constant_evaluated())
+            return cross<float, 4>(u, v);
+        __m128 a = _mm_load_ps(u.data());
+        __m128 b = _mm_load_ps(v.data());
+        __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 r = _mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx));
+        r = _mm_and_ps(r, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+        Vector<float, 4> res;
+        _mm_store_ps(res.data(), r);
+        return res;
+    }
+
+    template <std::same_as<Vector<float, 4>> A>
+    inline Vector<float, 4> unit_vector( const A & v ) {
+        __m128 x = _mm_load_ps(v.data());
+        float n = std::sqrt(simd::horizontal_sum(_mm_mul_ps(x, x)));
+        Vector<float, 4> res;
+        _mm_store_ps(res.data(), _mm_div_ps(x, _mm_set1_ps(n)));
+        return res;
+    }
+#endif
+
+#if defined(__AVX__)
+    // 4-wide double vectors are only 16-byte aligned, hence the unaligned loads
+    namespace simd {
+
+        inline void columns( const Matrix<double, 4, 4> & m, __m256d c[4] ) {
+            __m256d r0 = _mm256_loadu_pd(m[0].data());
+            __m256d r1 = _mm256_loadu_pd(m[1].data());
+            __m256d r2 = _mm256_loadu_pd(m[2].data());
+            __m256d r3 = _mm256_loadu_pd(m[3].data());
+            __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+            __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+            __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+            __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+            c[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+            c[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+            c[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+            c[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+        }
+
+        inline double horizontal_sum( __m256d p ) {
+            __m128d s = _mm_add_pd(_mm256_castpd256_pd128(p), _mm256_extractf128_pd(p, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+        }
+    }
+
+    template <std::same_as<Matrix<double, 4, 4>> A, std::same_as<Vector<double, 4>> B>
+    constexpr Vector<double, 4> operator*( const A & m, const B & v ) {
+        if (std::is_constant_evaluated())
+            return operator*<double, 4, 4>(m, v);
+        __m256d c[4];
+        simd::columns(m, c);
+        const double * x = v.data();
+        __m256d r = _mm256_mul_pd(c[0], _mm256_set1_pd(x[0]));
+        r = _mm256_add_pd(r, _mm256_mul_pd(c[1], _mm256_set1_pd(x[1])));
+        r = _mm256_add_pd(r, _mm256_mul_pd(c[2], _mm256_set1_pd(x[2])));
+        r = _mm256_add_pd(r, _mm256_mul_pd(c[3], _mm256_set1_pd(x[3])));
+        Vector<double, 4> res;
+        _mm256_storeu_pd(res.data(), r);
+        return res;
+    }
+
+    template <std::same_as<Matrix<double, 4, 4>> A, std::same_as<Matrix<double, 4, 4>> B>
+    constexpr Matrix<double, 4, 4> operator*( const A & m, const B & n ) {
+        if (std::is_constant_evaluated())
+            return Matrix<double, 4, 4>(operator*<double, 4, 4, 4>(m, n));
+        __m256d n0 = _mm256_loadu_pd(n[0].data());
+        __m256d n1 = _mm256_loadu_pd(n[1].data());
+        __m256d n2 = _mm256_loadu_pd(n[2].data());
+        __m256d n3 = _mm256_loadu_pd(n[3].data());
+        Matrix<double, 4, 4> res;
+        for (int i = 0; i < 4; i++) {
+            const double * a = m[i].data();
+            __m256d row = _mm256_mul_pd(n0, _mm256_set1_pd(a[0]));
+            row = _mm256_add_pd(row, _mm256_mul_pd(n1, _mm256_set1_pd(a[1])));
+            row = _mm256_add_pd(row, _mm256_mul_pd(n2, _mm256_set1_pd(a[2])));
+            row = _mm256_add_pd(row, _mm256_mul_pd(n3, _mm256_set1_pd(a[3])));
+            _mm256_storeu_pd(res[i].data(), row);
+        }
+        return res;
+    }
+
+    template <std::same_as<Vector<double, 4>> A, std::same_as<Vector<double, 4>> B>
+    constexpr double dot( const A & u, const B & v ) {
+        if (std::is_constant_evaluated())
+            return dot<double, 4>(u, v);
+        return simd::horizontal_sum(_mm256_mul_pd(_mm256_loadu_pd(u.data()), _mm256_loadu_pd(v.data())));
+    }
+
+#if defined(__AVX2__)
+    template <std::same_as<Vector<double, 4>> A, std::same_as<Vector<double, 4>> B>
+    constexpr Vector<double, 4> cross( const A & u, const B & v ) {
+        if (std::is_constant_evaluated())
+            return cross<double, 4>(u, v);
+        __m256d a = _mm256_loadu_pd(u.data());
+        __m256d b = _mm256_loadu_pd(v.data());
+        __m256d a_yzx = _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m256d b_yzx = _mm256_permute4x64_pd(b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m256d a_zxy = _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 1, 0, 2));
+        __m256d b_zxy = _mm256_permute4x64_pd(b, _MM_SHUFFLE(3, 1, 0, 2));
+        __m256d r = _mm256_sub_pd(_mm256_mul_pd(a_yzx, b_zxy), _mm256_mul_pd(a_zxy, b_yzx));
+        r = _mm256_blend_pd(r, _mm256_setzero_pd(), 0x8);
+        Vector<double, 4> res;
+        _mm256_storeu_pd(res.data(), r);
+        return res;
+    }
+#endif
+
+    template <std::same_as<Vector<double, 4>> A>
+    inline Vector<double, 4> unit_vector( const A & v ) {
+        __m256d x = _mm256_loadu_pd(v.data());
+        double n = std::sqrt(simd::horizontal_sum(_mm256_mul_pd(x, x)));
+        Vector<double, 4> res;
+        _mm256_storeu_pd(res.data(), _mm256_div_pd(x, _mm256_set1_pd(n)));
+        return res;
+    }
+#endif
+}
+
+#endif // _ALINE_SIMD_H_
@@ -0,0 +1,198 @@
+#ifndef _ALINE_TILER_H_
+#define _ALINE_TILER_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include "vector.h"
+#include "framebuffer.h"
+#include "halfspace.h"
+
+namespace aline {
+
+    // triangle after transform and projection, in window coordinates
+    template <class S>
+    struct ScreenTriangle {
+        Vec2i p[3];
+        S z[3];
+        minwin::Color color;
+    };
+
+    // sort-middle renderer: triangles are binned into screen tiles during
+    // the frame and flush() rasterizes the tiles in parallel, each one into
+    // its own color and depth storage before it is copied to its (disjoint)
+    // rectangle of the framebuffer
+    template <class S>
+    class TileRenderer {
+        private:
+            int tile_size;
+            int width;
+            int height;
+            int tiles_x;
+            int tiles_y;
+            std::vector<ScreenTriangle<S>> triangles;
+            std::vector<std::vector<uint>> bins;
+            std::vector<BasicFramebuffer<S>> tiles;
+
+            // worker pool, woken up once per flush()
+            std::vector<std::thread> workers;
+            std::mutex mutex;
+            std::condition_variable start_cv;
+            std::condition_variable done_cv;
+            unsigned long generation;
+            int busy_workers;
+            bool stopping;
+            std::atomic<int> next_tile;
+            BasicFramebuffer<S> * target;
+
+            void render_tile( int t ) {
+                BasicFramebuffer<S> & tile = tiles[t];
+                int ox = (t % tiles_x) * tile_size;
+                int oy = (t / tiles_x) * tile_size;
+                tile.clear(target->get_clear_color());
+
+                // the triangle is moved into tile coordinates, the integer
+                // translation leaves the edge functions unchanged
+                Vec2i origin {ox, oy};
+                for (uint i : bins[t]) {
+                    const ScreenTriangle<S> & tri = triangles[i];
+                    halfspace::fill_triangle(tile, tri.p[0] - origin, tri.z[0], tri.p[1] - origin, tri.z[1],
+                                             tri.p[2] - origin, tri.z[2], tri.color);
+                }
+
+                target->copy_from(tile, ox, oy);
+            }
+
+            void render_tiles() {
+                const int tile_count = tiles_x * tiles_y;
+                for (int t = next_tile++; t < tile_count; t = next_tile++)
+                    render_tile(t);
+            }
+
+            void work() {
+                unsigned long seen = 0;
+                while (true) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        start_cv.wait(lock, [&] { return stopping || generation != seen; });
+                        if (stopping)
+                            return;
+                        seen = generation;
+                    }
+                    render_tiles();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        busy_workers--;
+                    }
+                    done_cv.notify_one();
+                }
+            }
+
+        public:
+            // thread_count includes the calling thread, 0 picks one per core
+            TileRenderer( int tile_size = 64, uint thread_count = 0 ) {
+                this->tile_size = tile_size;
+                width = 0;
+                height = 0;
+                tiles_x = 0;
+                tiles_y = 0;
+                generation = 0;
+                busy_workers = 0;
+                stopping = false;
+                next_tile = 0;
+                target = nullptr;
+                if (thread_count == 0)
+                    thread_count = std::max(1u, std::thread::hardware_concurrency());
+                for (uint i = 1; i < thread_count; i++)
+                    workers.push_back(std::thread(&TileRenderer::work, this));
+            }
+
+            ~TileRenderer() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                start_cv.notify_all();
+                for (std::thread & worker : workers)
+                    worker.join();
+            }
+
+            TileRenderer( const TileRenderer & ) = delete;
+            TileRenderer & operator=( const TileRenderer & ) = delete;
+
+            void resize( int width, int height ) {
+                this->width = width;
+                this->height = height;
+                tiles_x = (width + tile_size - 1) / tile_size;
+                tiles_y = (height + tile_size - 1) / tile_size;
+                bins.assign(tiles_x * tiles_y, std::vector<uint>());
+                tiles.clear();
+                for (int i = 0; i < tiles_x * tiles_y; i++)
+                    tiles.push_back(BasicFramebuffer<S>(tile_size, tile_size));
+            }
+
+            uint get_thread_count() const {
+                return workers.size() + 1;
+            }
+
+            // returns false, without binning it, for a triangle the half-space
+            // rasterizer cannot handle (outside the guard band); the band is
+            // narrowed by the largest tile origin, which render_tile
+            // subtracts from the vertices
+            bool add_triangle( const Vec2i & p0, S z0, const Vec2i & p1, S z1, const Vec2i & p2, S z2,
+                               const minwin::Color & color ) {
+                const Vec2i * p[3] = { &p0, &p1, &p2 };
+                const int band = halfspace::GUARD_BAND - std::max(width, height);
+                int xmin = width, ymin = height, xmax = -1, ymax = -1;
+                for (int k = 0; k < 3; k++) {
+                    int x = (*p[k])[0];
+                    int y = (*p[k])[1];
+                    if (std::abs(x) >= band || std::abs(y) >= band)
+                        return false;
+                    xmin = std::min(xmin, x);
+                    ymin = std::min(ymin, y);
+                    xmax = std::max(xmax, x);
+                    ymax = std::max(ymax, y);
+                }
+                xmin = std::max(xmin, 0);
+                ymin = std::max(ymin, 0);
+                xmax = std::min(xmax, width - 1);
+                ymax = std::min(ymax, height - 1);
+                if (xmin > xmax || ymin > ymax)
+                    return true;
+
+                uint index = triangles.size();
+                triangles.push_back(ScreenTriangle<S> { {p0, p1, p2}, {z0, z1, z2}, color });
+                for (int ty = ymin / tile_size; ty <= ymax / tile_size; ty++)
+                    for (int tx = xmin / tile_size; tx <= xmax / tile_size; tx++)
+                        bins[ty * tiles_x + tx].push_back(index);
+                return true;
+            }
+
+            // rasterizes everything binned since the last flush into fb
+            void flush( BasicFramebuffer<S> & fb ) {
+                target = &fb;
+                next_tile = 0;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    busy_workers = workers.size();
+                    generation++;
+                }
+                start_cv.notify_all();
+                render_tiles();
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    done_cv.wait(lock, [&] { return busy_workers == 0; });
+                }
+
+                triangles.clear();
+                for (std::vector<uint> & bin : bins)
+                    bin.clear();
+            }
+    };
+}
+
+#endif // _ALINE_TILER_H_
@@ -1,60 +1,199 @@
+#ifndef _ALINE_VECTOR_H_
+#define _ALINE_VECTOR_H_
+
 #include <iostream>
 #include <float.h>
 #include <string>
 #include <cmath>
 #include <sstream>
+#include <type_traits>
+
+// operator[] of Vector and Matrix checks its index when ALINE_BOUNDS_CHECK is
+// non-zero, which is the default unless NDEBUG is defined; at() always checks
+#ifndef ALINE_BOUNDS_CHECK
+#ifdef NDEBUG
+#define ALINE_BOUNDS_CHECK 0
+#else
+#define ALINE_BOUNDS_CHECK 1
+#endif
+#endif
 
 namespace aline {
+    template <class T, int N> class Vector;
+    template <class T, int M, int N> class Matrix;
+
+    // Vector, Matrix, their arithmetic and the factories of matrix.h are
+    // constexpr, so constant transforms can be built at compile time.
+    // The arithmetic is lazy: the operators build small
+    // expression objects and the whole expression is evaluated in a single
+    // loop when it is assigned to a Vector or a Matrix, without temporaries.
+    // Vectors and matrices are held by reference in an expression and the
+    // intermediate expressions by value, so an expression must not outlive
+    // its operands (no auto on an expression).
+    template <class E>
+    struct expr_operand {
+        using type = const E;
+    };
+
+    template <class T, int N>
+    struct expr_operand<Vector<T, N>> {
+        using type = const Vector<T, N> &;
+    };
+
+    template <class T, int M, int N>
+    struct expr_operand<Matrix<T, M, N>> {
+        using type = const Matrix<T, M, N> &;
+    };
+
+    // element-wise operations of the expressions
+    struct ExprAdd {
+        template <class T> static constexpr T apply(const T& a, const T& b) { return a + b; }
+    };
+
+    struct ExprSub {
+        template <class T> static constexpr T apply(const T& a, const T& b) { return a - b; }
+    };
+
+    struct ExprMul {
+        template <class T> static constexpr T apply(const T& a, const T& b) { return a * b; }
+    };
+
+    struct ExprDiv {
+        template <class T> static constexpr T apply(const T& a, const T& b) { return a / b; }
+    };
+
+    // a scalar operand, the same value at every index
+    template <class T>
+    class ExprScalar {
+        private:
+            T t;
+        public:
+            constexpr ExprScalar(const T& t) : t(t) {}
+
+            constexpr T operator[](size_t) const {
+                return t;
+            }
+
+            constexpr T operator()(size_t, size_t) const {
+                return t;
+            }
+    };
+
+    template <class E, class T, int N>
+    class VectorExpr {
+        public:
+            constexpr const E & self() const {
+                return static_cast<const E &>(*this);
+            }
+    };
+
+    template <class E1, class E2, class Op, class T, int N>
+    class VectorBinaryExpr : public VectorExpr<VectorBinaryExpr<E1, E2, Op, T, N>, T, N> {
+        private:
+            typename expr_operand<E1>::type u;
+            typename expr_operand<E2>::type v;
+        public:
+            constexpr VectorBinaryExpr(const E1& u, const E2& v) : u(u), v(v) {}
+
+            constexpr T operator[](size_t i) const {
+                return Op::apply(u[i], v[i]);
+            }
+    };
+
+    template <class E, class T, int N>
+    class VectorNegateExpr : public VectorExpr<VectorNegateExpr<E, T, N>, T, N> {
+        private:
+            typename expr_operand<E>::type v;
+        public:
+            constexpr VectorNegateExpr(const E& v) : v(v) {}
+
+            constexpr T operator[](size_t i) const {
+                return -v[i];
+            }
+    };
+
+    // 4-wide float and double vectors are 16-byte aligned for the SSE/AVX
+    // kernels of simd.h
+    template <class T, int N>
+    constexpr size_t vector_alignment() {
+        return N == 4 && (std::is_same<T, float>::value || std::is_same<T, double>::value) ? 16 : alignof(T);
+    }
+
     template <class T, int N>
-    class Vector {
+    class Vector : public VectorExpr<Vector<T, N>, T, N> {
         private:
-            T vector[N];
+            alignas(vector_alignment<T, N>()) T vector[N];
         public:
-            Vector() {
+            constexpr Vector() {
                 for (int i = 0; i < N; i++) {
                     vector[i] = 0;
                 }
             }
 
-            Vector(std::initializer_list<T> list) {
+            constexpr Vector(std::initializer_list<T> list) {
                 if (list.size() > (size_t) N)
                     throw std::runtime_error("list size bigger than N");
-                T l[list.size()];
-                int s = 0;
-                for (auto& i : list) {
-                    l[s++] = i;
+                int i = 0;
+                for (const T& t : list) {
+                    vector[i++] = t;
+                }
+                for (; i < N; i++) {
+                    vector[i] = 0;
                 }
+            }
+
+            template <class E>
+            constexpr Vector(const VectorExpr<E, T, N>& e) {
+                const E & x = e.self();
                 for (int i = 0; i < N; i++) {
-                    if ((size_t) i >= list.size())
-                        vector[i] = 0;
-                    else
-                        vector[i] = l[i];
+                    vector[i] = x[i];
                 }
             }
 
-            Vector( const Vector<T,N> &v ) {
+            // element i of an expression only reads element i of its operands,
+            // so the expression can be evaluated in place
+            template <class E>
+            constexpr Vector<T,N> & operator=(const VectorExpr<E, T, N>& e) {
+                const E & x = e.self();
                 for (int i = 0; i < N; i++) {
-                    vector[i] = v[i];
+                    vector[i] = x[i];
                 }
+                return *this;
             }
 
-            T at(size_t i) const {
+            constexpr T at(size_t i) const {
                 if (i >= N)
                     throw std::runtime_error("Vector: index out of range");
                 return vector[i];
             }
 
-            T operator[](size_t i) const {
-                return at(i);
+            constexpr const T & operator[](size_t i) const {
+#if ALINE_BOUNDS_CHECK
+                if (i >= N)
+                    throw std::runtime_error("Vector: index out of range");
+#endif
+                return vector[i];
             }
 
-            T & operator[](size_t i) {
+            constexpr T & operator[](size_t i) {
+#if ALINE_BOUNDS_CHECK
                 if (i >= N)
                     throw std::runtime_error("Vector: index out of range");
+#endif
                 return vector[i];
             }
 
-            Vector<T,N> & operator+=(const Vector<T,N> & v) {
+            constexpr T * data() {
+                return vector;
+            }
+
+            constexpr const T * data() const {
+                return vector;
+            }
+
+            template <class E>
+            constexpr Vector<T,N> & operator+=(const VectorExpr<E, T, N>& e) {
+                const E & v = e.self();
                 for (int i = 0; i < N; i++) {
                     vector[i] += v[i];
                 }
@@ -62,9 +201,11 @@ namespace aline {
             }
     };
 
-    template <class T, int N> Vector<T, N> cross(const Vector<T, N>& u, const Vector<T, N>& v) {
+    template <class T, int N, class E1, class E2> constexpr Vector<T, N> cross(const VectorExpr<E1, T, N>& a, const VectorExpr<E2, T, N>& b) {
         if (N < 3)
             throw std::runtime_error("Vector need at least 3 elements");
+        const E1 & u = a.self();
+        const E2 & v = b.self();
         Vector<T, N> cross_P;
         cross_P[0] = u[1] * v[2] - u[2] * v[1];
         cross_P[1] = u[2] * v[0] - u[0] * v[2];
@@ -72,7 +213,9 @@ namespace aline {
         return cross_P;
     }
 
-    template <class T, int N> T dot(const Vector<T, N>& u, const Vector<T, N>& v) {
+    template <class T, int N, class E1, class E2> constexpr T dot(const VectorExpr<E1, T, N>& a, const VectorExpr<E2, T, N>& b) {
+        const E1 & u = a.self();
+        const E2 & v = b.self();
         T product = 0;
 
         for (int i = 0; i < N; i++)
@@ -81,17 +224,20 @@ namespace aline {
         return product;
     }
 
-    template <class T, int N> bool isnan(const Vector<T, N>& v) {
+    template <class T, int N, class E> bool isnan(const VectorExpr<E, T, N>& e) {
+        const E & v = e.self();
         for (int i = 0; i < N; i++)
             if (std::isnan(v[i])) return true;
         return false;
     }
 
-    template <class T, int N> bool is_unit(const Vector<T, N>& v) {
+    template <class T, int N, class E> bool is_unit(const VectorExpr<E, T, N>& v) {
         return std::round(norm(v)) == 1; // using round because double aren't as precise as floats
     }
 
-    template <class T, int N> bool nearly_equal(const Vector<T, N>& u, const Vector<T, N>& v) {
+    template <class T, int N, class E1, class E2> bool nearly_equal(const VectorExpr<E1, T, N>& a, const VectorExpr<E2, T, N>& b) {
+        const E1 & u = a.self();
+        const E2 & v = b.self();
         float A;
         float B;
         for (int i = 0; i < N; i++) {
@@ -108,11 +254,13 @@ namespace aline {
         return true;
     }
 
-    template <class T, int N> T norm(const Vector<T, N>& v) {
+    template <class T, int N, class E> T norm(const VectorExpr<E, T, N>& v) {
         return sqrt(dot(v, v));
     }
 
-    template <class T, int N> bool operator==(const Vector<T, N>& u, const Vector<T, N>& v) {
+    template <class T, int N, class E1, class E2> constexpr bool operator==(const VectorExpr<E1, T, N>& a, const VectorExpr<E2, T, N>& b) {
+        const E1 & u = a.self();
+        const E2 & v = b.self();
         for (int i = 0; i < N; i++) {
             if (u[i] != v[i])
                 return false;
@@ -120,7 +268,9 @@ namespace aline {
         return true;
     }
 
-    template <class T, int N> bool operator!=(const Vector<T, N>& u, const Vector<T, N>& v) {
+    template <class T, int N, class E1, class E2> constexpr bool operator!=(const VectorExpr<E1, T, N>& a, const VectorExpr<E2, T, N>& b) {
+        const E1 & u = a.self();
+        const E2 & v = b.self();
         for (int i = 0; i < N; i++) {
             if (u[i] == v[i])
                 return false;
@@ -128,74 +278,53 @@ namespace aline {
         return true;
     }
 
-    template <class T, int N> std::ostream& operator<<(std::ostream& out, const Vector<T, N>& v) {
+    template <class T, int N, class E> std::ostream& operator<<(std::ostream& out, const VectorExpr<E, T, N>& v) {
         out << to_string(v);
         return out;
     }
 
-    template <class T, int N> Vector<T, N> operator+(const Vector<T, N>& u, const Vector<T, N>& v) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = u[i] + v[i];
-        }
-        return res;
+    template <class T, int N, class E1, class E2>
+    constexpr VectorBinaryExpr<E1, E2, ExprAdd, T, N> operator+(const VectorExpr<E1, T, N>& u, const VectorExpr<E2, T, N>& v) {
+        return VectorBinaryExpr<E1, E2, ExprAdd, T, N>(u.self(), v.self());
     }
 
-    template <class T, int N> Vector<T, N> operator-(const Vector<T, N>& v) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = -v[i];
-        }
-        return res;
+    template <class T, int N, class E> constexpr VectorNegateExpr<E, T, N> operator-(const VectorExpr<E, T, N>& v) {
+        return VectorNegateExpr<E, T, N>(v.self());
     }
 
-    template <class T, int N> Vector<T, N> operator-(const Vector<T, N>& u, const Vector<T, N>& v) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = u[i] - v[i];
-        }
-        return res;
+    template <class T, int N, class E1, class E2>
+    constexpr VectorBinaryExpr<E1, E2, ExprSub, T, N> operator-(const VectorExpr<E1, T, N>& u, const VectorExpr<E2, T, N>& v) {
+        return VectorBinaryExpr<E1, E2, ExprSub, T, N>(u.self(), v.self());
     }
 
-    template <class T, int N> Vector<T, N> operator*(const T& t, const Vector<T, N>& v) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = t * v[i];
-        }
-        return res;
+    template <class T, int N, class E>
+    constexpr VectorBinaryExpr<ExprScalar<T>, E, ExprMul, T, N> operator*(const T& t, const VectorExpr<E, T, N>& v) {
+        return VectorBinaryExpr<ExprScalar<T>, E, ExprMul, T, N>(ExprScalar<T>(t), v.self());
     }
 
-    template <class T, int N> Vector<T, N> operator*(const Vector<T, N>& v, const T& t) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = v[i] * t;
-        }
-        return res;
+    template <class T, int N, class E>
+    constexpr VectorBinaryExpr<E, ExprScalar<T>, ExprMul, T, N> operator*(const VectorExpr<E, T, N>& v, const T& t) {
+        return VectorBinaryExpr<E, ExprScalar<T>, ExprMul, T, N>(v.self(), ExprScalar<T>(t));
     }
 
-    template <class T, int N> Vector<T, N> operator*(const Vector<T, N>& u, const Vector<T, N>& v) {
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = u[i] * v[i];
-        }
-        return res;
+    template <class T, int N, class E1, class E2>
+    constexpr VectorBinaryExpr<E1, E2, ExprMul, T, N> operator*(const VectorExpr<E1, T, N>& u, const VectorExpr<E2, T, N>& v) {
+        return VectorBinaryExpr<E1, E2, ExprMul, T, N>(u.self(), v.self());
     }
 
-    template <class T, int N> Vector<T, N> operator/(const Vector<T, N>& v, const T& t) {
+    template <class T, int N, class E>
+    constexpr VectorBinaryExpr<E, ExprScalar<T>, ExprDiv, T, N> operator/(const VectorExpr<E, T, N>& v, const T& t) {
         if (t == 0)
             throw std::runtime_error("div by zero");
-        Vector<T, N> res;
-        for (int i = 0; i < N; i++) {
-            res[i] = v[i] / t;
-        }
-        return res;
+        return VectorBinaryExpr<E, ExprScalar<T>, ExprDiv, T, N>(v.self(), ExprScalar<T>(t));
     }
 
-    template <class T, int N> T sq_norm(const Vector<T, N>& v) {
+    template <class T, int N, class E> T sq_norm(const VectorExpr<E, T, N>& v) {
         return norm(v) * norm(v);
     }
 
-    template <class T, int N> std::string to_string(const Vector<T, N>& v) {
+    template <class T, int N, class E> std::string to_string(const VectorExpr<E, T, N>& e) {
+        const E & v = e.self();
         std::stringstream s;
         s << "(";
         for (int i = 0; i < N; i++) {
@@ -205,10 +334,12 @@ namespace aline {
         return s.str();
     }
 
-    template <class T, int N> Vector<T, N> unit_vector(const Vector<T, N>& v) {
+    template <class T, int N, class E> Vector<T, N> unit_vector(const VectorExpr<E, T, N>& e) {
+        const E & v = e.self();
+        const T n = norm(e);
         Vector<T, N> res;
         for (int i = 0; i < N; i++) {
-            res[i] = v[i] / norm(v);
+            res[i] = v[i] / n;
         }
         return res;
     }
@@ -218,7 +349,12 @@ using uint = unsigned int;
 using real = double;
 using Vec2i = aline::Vector<int,2ul>;
 using Vec2r = aline::Vector<real,2ul>;
+using Vec2f = aline::Vector<float,2ul>;
 using Vec3i = aline::Vector<int,3ul>;
 using Vec3r = aline::Vector<real,3ul>;
+using Vec3f = aline::Vector<float,3ul>;
 using Vec4i = aline::Vector<int,4ul>;
-using Vec4r = aline::Vector<real,4ul>;
\ No newline at end of file
+using Vec4r = aline::Vector<real,4ul>;
+using Vec4f = aline::Vector<float,4ul>;
+
+#endif // _ALINE_VECTOR_H_
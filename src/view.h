@@ -0,0 +1,66 @@
+#ifndef _ALINE_VIEW_H_
+#define _ALINE_VIEW_H_
+
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+namespace aline {
+
+    // read-only, non-owning view over contiguous elements; it stays valid as
+    // long as the storage it was made from is neither destroyed nor resized
+    template <class T>
+    class View {
+        private:
+            const T * first;
+            size_t count;
+        public:
+            View() {
+                first = nullptr;
+                count = 0;
+            }
+
+            View( const T * data, size_t size ) {
+                first = data;
+                count = size;
+            }
+
+            template <class Allocator>
+            View( const std::vector<T, Allocator> & v ) {
+                first = v.data();
+                count = v.size();
+            }
+
+            const T * data() const {
+                return first;
+            }
+
+            size_t size() const {
+                return count;
+            }
+
+            bool empty() const {
+                return count == 0;
+            }
+
+            const T & at( size_t i ) const {
+                if (i >= count)
+                    throw std::runtime_error("View: index out of range");
+                return first[i];
+            }
+
+            const T & operator[]( size_t i ) const {
+                return first[i];
+            }
+
+            const T * begin() const {
+                return first;
+            }
+
+            const T * end() const {
+                return first + count;
+            }
+    };
+}
+
+#endif // _ALINE_VIEW_H_
@@ -1,11 +1,90 @@
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+// counts heap allocations, see alloc_counter.h
+#define ALINE_COUNT_ALLOCATIONS
 #include "scene.h"
 using namespace aline;
 
-int main(int argc, char* argv[]) {
-    Scene scene;
-    scene.initialise();
-    scene.load_data(argc, argv);
+// usage: test_3d [--headless N] [--dump PREFIX] [--filled] [--halfspace|--tiled] [--double] file.obj ...
+//   --headless N   render N frames without opening a window and report timings
+//   --dump PREFIX  with --headless, write every frame to PREFIX0000.ppm, ...
+//   --filled       start in filled mode instead of wireframe
+//   --halfspace    fill triangles with the half-space rasterizer instead of scanlines
+//   --tiled        fill triangles with the half-space rasterizer on 64x64 tiles, one thread per core
+//   --double       run the render pipeline in double instead of float
+template <class S>
+void render(bool headless, uint frames, const std::string & dump_prefix, bool filled, int rasterizer,
+            int file_count, char* argv[]) {
+    BasicScene<S> scene;
+    if (headless)
+        scene.initialise_headless(frames, dump_prefix);
+    else
+        scene.initialise();
+    if (filled)
+        scene.set_display(1);
+    scene.set_rasterizer(rasterizer);
+    auto load_start = std::chrono::steady_clock::now();
+    scene.load_data(file_count, argv);
+    // a window opens and shows the objects as they arrive, a headless run
+    // waits for all of them and times the loading apart from the frames
+    if (headless) {
+        scene.finish_loading();
+        auto load_end = std::chrono::steady_clock::now();
+        std::cout << "loaded in " << std::chrono::duration<double, std::milli>(load_end - load_start).count() << " ms" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
     scene.run();
+    auto end = std::chrono::steady_clock::now();
+
+    if (headless) {
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << frames << " frames in " << ms << " ms ("
+                  << (frames > 0 ? ms / frames : 0) << " ms/frame)" << std::endl;
+        std::cout << "heap allocations in the last frame: " << scene.get_stats().allocations << std::endl;
+        std::cout << "vertices transformed in the last frame: " << scene.get_stats().vertices_transformed << std::endl;
+        std::cout << "matrix rebuilds in the last frame: " << scene.get_stats().matrix_rebuilds << std::endl;
+        std::cout << "objects drawn / culled in the last frame: " << scene.get_stats().objects_visible
+                  << " / " << scene.get_stats().objects_culled << std::endl;
+        std::cout << "triangles clipped in the last frame: " << scene.get_stats().triangles_clipped << std::endl;
+        std::cout << "triangles culled in the last frame: " << scene.get_stats().triangles_culled << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint frames = 0;
+    bool headless = false;
+    bool filled = false;
+    bool use_double = false;
+    int rasterizer = 0;
+    std::string dump_prefix;
+
+    // strip the options so that load_data only sees file names
+    int file_count = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headless = true;
+            frames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dump_prefix = argv[++i];
+        } else if (std::strcmp(argv[i], "--filled") == 0) {
+            filled = true;
+        } else if (std::strcmp(argv[i], "--halfspace") == 0) {
+            rasterizer = 1;
+        } else if (std::strcmp(argv[i], "--tiled") == 0) {
+            rasterizer = 2;
+        } else if (std::strcmp(argv[i], "--double") == 0) {
+            use_double = true;
+        } else {
+            argv[file_count++] = argv[i];
+        }
+    }
+
+    if (use_double)
+        render<double>(headless, frames, dump_prefix, filled, rasterizer, file_count, argv);
+    else
+        render<float>(headless, frames, dump_prefix, filled, rasterizer, file_count, argv);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,151 @@
+//
+// File       : test_async_load.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests ConcurrentQueue and the background loading of Scene: load_data
+// returns at once, the objects arrive through the queue, and the error of
+// a file that can't be loaded reaches the render loop.
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <cstdio>       // std::remove
+#include <fstream>      // std::ofstream
+#include <stdexcept>    // std::invalid_argument
+#include <thread>       // std::thread
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "scene.h"
+
+using namespace aline;
+
+int test_queue()
+{
+  const int producers = 4;
+  const int items = 10000;
+  ConcurrentQueue<int> queue;
+  std::vector<std::thread> threads;
+  for( int p = 0; p < producers; p++ )
+    threads.emplace_back( [&queue, p]() {
+      for( int i = 0; i < items; i++ )
+        queue.push( p * items + i );
+    } );
+
+  // every item once, and each producer's items in their order
+  std::vector<int> last( producers, -1 );
+  std::vector<bool> seen( producers * items, false );
+  bool ordered = true;
+  for( int n = 0; n < producers * items; n++ )
+  {
+    int item = queue.pop();
+    ordered = ordered && !seen[ item ] && item % items > last[ item / items ];
+    seen[ item ] = true;
+    last[ item / items ] = item % items;
+  }
+  for( std::thread & t : threads )
+    t.join();
+
+  int item = 0;
+  bool drained = queue.empty() && !queue.try_pop( item );
+  queue.push( 7 );
+  bool popped = queue.size() == 1 && queue.try_pop( item ) && item == 7 && queue.empty();
+
+  TestVector test_vec
+    { { "every item once, in order per producer", ordered }
+    , { "empty once drained", drained }
+    , { "try_pop", popped } };
+
+  return run_tests( "ConcurrentQueue", test_vec );
+}
+
+// a grid of 600 x 600 vertices in front of the camera, large enough for
+// its loading to be measurable
+const char * GRID_FILE = "test_async_load.obj";
+
+void write_grid()
+{
+  std::ofstream out( GRID_FILE );
+  const int n = 600;
+  for( int i = 0; i < n; i++ )
+    for( int j = 0; j < n; j++ )
+      out << "v " << ( i - n / 2 ) * 0.1 << " " << ( j - n / 2 ) * 0.1 << " 0\n";
+  for( int i = 0; i + 1 < n; i++ )
+    for( int j = 0; j + 1 < n; j++ )
+    {
+      int v = i * n + j + 1;
+      out << "f " << v << " " << v + n << " " << v + 1 << "\n";
+    }
+}
+
+int test_scene()
+{
+  std::remove( mesh_cache_path( GRID_FILE ).c_str() );
+  write_grid();
+  char grid[] = "test_async_load.obj";
+  char teapot[] = "teapot.obj";
+  char * argv[] = { nullptr, grid, teapot };
+
+  BasicScene<float> scene;
+  scene.initialise_headless( 1 );
+  auto start = std::chrono::steady_clock::now();
+  scene.load_data( 3, argv );
+  auto returned = std::chrono::steady_clock::now();
+  scene.finish_loading();
+  auto loaded = std::chrono::steady_clock::now();
+  scene.run();
+
+  double return_ms = std::chrono::duration<double, std::milli>( returned - start ).count();
+  double load_ms = std::chrono::duration<double, std::milli>( loaded - start ).count();
+  std::cout << "load_data returned after " << return_ms << " ms, files loaded after " << load_ms << " ms" << std::endl;
+
+  // the first frame of a headless run waits for the files by itself
+  BasicScene<float> waiting;
+  waiting.initialise_headless( 1 );
+  waiting.load_data( 3, argv );
+  waiting.run();
+
+  char missing[] = "test_async_load_missing.obj";
+  char * bad_argv[] = { nullptr, teapot, missing };
+  BasicScene<float> failing;
+  failing.initialise_headless( 1 );
+  failing.load_data( 3, bad_argv );
+  bool thrown = false;
+  try
+  {
+    failing.run();
+  }
+  catch( const std::invalid_argument & )
+  {
+    thrown = true;
+  }
+
+  TestVector test_vec
+    { { "load_data does not wait", 5 * return_ms < load_ms }
+    , { "both objects drawn", scene.get_stats().objects_visible == 2 }
+    , { "first headless frame waits", waiting.get_stats().objects_visible == 2 }
+    , { "loading error rethrown by run", thrown } };
+
+  std::remove( mesh_cache_path( GRID_FILE ).c_str() );
+  std::remove( GRID_FILE );
+  return run_tests( "background loading", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_queue();
+    failures += test_scene();
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,95 @@
+//
+// File       : test_clip.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests near plane and guard band clipping on geometry that crosses the
+// camera plane and reaches far outside the window.
+//
+
+#include <cstdio>       // std::remove
+#include <fstream>      // std::ofstream
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "scene.h"
+
+using namespace aline;
+
+// objects are loaded at ( 40, 0, 3000 ): a floor 100 below the camera from
+// z = 10 to z = 8000 and ten thousand wide at the front, and a triangle 10
+// above the camera going from z = -500 behind it to z = 1000 in front of it,
+// both facing the camera
+const char * FILE_NAME = "test_clip.obj";
+
+void write_obj()
+{
+  std::ofstream out( FILE_NAME );
+  out << "v -5040 -100 -2990\n"
+      << "v 4960 -100 -2990\n"
+      << "v -40 -100 5000\n"
+      << "v -40 10 -3500\n"
+      << "v -240 10 -2000\n"
+      << "v 160 10 -2000\n"
+      << "f 1 3 2\n"
+      << "f 4 6 5\n";
+}
+
+template <class S>
+int test_render( const std::string & name, int display, int rasterizer )
+{
+  BasicScene<S> scene;
+  scene.initialise_headless( 2 );
+  scene.set_display( display );
+  scene.set_rasterizer( rasterizer );
+  char file_name[] = "test_clip.obj";
+  char * argv[] = { nullptr, file_name };
+  scene.load_data( 2, argv );
+  scene.run();
+
+  const BasicFramebuffer<S> & fb = scene.get_framebuffer();
+  int drawn = 0;
+  for( int y = 0; y < fb.get_height(); y++ )
+    for( int x = 0; x < fb.get_width(); x++ )
+      if( !ColorBuffer::same_color( fb.get_pixel( x, y ), fb.get_clear_color() ) )
+        drawn++;
+
+  // the floor is seen at row 700 below the camera, z = 6667; the
+  // triangle crossing the camera plane covers the top of the window
+  TestVector test_vec
+    { { "both triangles clipped", scene.get_stats().triangles_clipped == 2 }
+    , { "something drawn", drawn > 0 } };
+  if( display == 1 )
+  {
+    test_vec.push_back( { "floor under the camera", !ColorBuffer::same_color( fb.get_pixel( 400, 700 ), fb.get_clear_color() ) } );
+    test_vec.push_back( { "triangle over the camera", !ColorBuffer::same_color( fb.get_pixel( 400, 100 ), fb.get_clear_color() ) } );
+    test_vec.push_back( { "nothing at the horizon", ColorBuffer::same_color( fb.get_pixel( 400, 402 ), fb.get_clear_color() ) } );
+  }
+
+  return run_tests( name, test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    write_obj();
+    failures += test_render<float>( "wireframe", 0, 0 );
+    failures += test_render<float>( "scanline", 1, 0 );
+    failures += test_render<float>( "half-space", 1, 1 );
+    failures += test_render<float>( "tiled", 1, 2 );
+    failures += test_render<double>( "scanline in double", 1, 0 );
+    std::remove( FILE_NAME );
+    std::remove( mesh_cache_path( FILE_NAME ).c_str() );
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,164 @@
+//
+// File       : test_cull.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests backface culling with each CullMode, on a triangle facing the
+// camera and one facing away from it, and on teapot.obj, whose visible
+// surface culling must leave as it is.
+//
+
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "scene.h"
+
+using namespace aline;
+
+// at z = 1000 a unit is 20 pixels: the triangle facing the camera spans
+// x in [100, 300] of the window, the other one x in [500, 700]
+Shape two_triangles()
+{
+  std::vector<Vertex> vertices
+    { Vertex( { -15, -5, 0 }, 1 ), Vertex( { -5, -5, 0 }, 1 ), Vertex( { -10, 5, 0 }, 1 )
+    , Vertex( { 5, -5, 0 }, 1 ), Vertex( { 15, -5, 0 }, 1 ), Vertex( { 10, 5, 0 }, 1 ) };
+  std::vector<Face> faces { Face( 0, 2, 1, minwin::WHITE ), Face( 3, 4, 5, minwin::WHITE ) };
+  return Shape( "two triangles", vertices, faces );
+}
+
+template <class S>
+int test_mode( const std::string & name, const Shape & shape, CullMode mode, int display, int rasterizer )
+{
+  BasicScene<S> scene;
+  scene.initialise_headless( 1 );
+  scene.set_display( display );
+  scene.set_rasterizer( rasterizer );
+  Object o( shape, { 0, 0, 1000 }, { 0, 0, 0 }, { 1, 1, 1 } );
+  o.set_cull_mode( mode );
+  scene.add_object( o );
+  scene.run();
+
+  const BasicFramebuffer<S> & fb = scene.get_framebuffer();
+  bool front = !ColorBuffer::same_color( fb.get_pixel( 200, 420 ), fb.get_clear_color() );
+  bool back = !ColorBuffer::same_color( fb.get_pixel( 600, 420 ), fb.get_clear_color() );
+  unsigned long culled = scene.get_stats().triangles_culled;
+
+  TestVector test_vec
+    { { "front face drawn", front == ( mode != CullMode::Front ) }
+    , { "back face drawn", back == ( mode != CullMode::Back ) }
+    , { "culled count", culled == ( mode == CullMode::None ? 0 : 1 ) } };
+
+  return run_tests( name, test_vec );
+}
+
+// depth buffer of the shape drawn as Scene::add_shape places it
+template <class S>
+BasicFramebuffer<S> render( const Shape & shape, CullMode mode, int rasterizer, unsigned long & culled )
+{
+  BasicScene<S> scene;
+  scene.initialise_headless( 1 );
+  scene.set_display( 1 );
+  scene.set_rasterizer( rasterizer );
+  Object o( shape, { 40, 0, 3000 }, { 0, 0, 0 }, { 1, 1, 1 } );
+  o.set_cull_mode( mode );
+  scene.add_object( o );
+  scene.run();
+  culled = scene.get_stats().triangles_culled;
+  return scene.get_framebuffer();
+}
+
+// sum of the tetrahedra spanned by the origin and each face: positive
+// when the faces are wound counter-clockwise seen from outside
+double signed_volume( const Shape & shape )
+{
+  double volume = 0;
+  for( size_t f = 0; f < shape.face_count(); f++ )
+  {
+    Vec3r a = shape.get_vertex( shape.get_face( f ).get_v0() ).get_vector();
+    Vec3r b = shape.get_vertex( shape.get_face( f ).get_v1() ).get_vector();
+    Vec3r c = shape.get_vertex( shape.get_face( f ).get_v2() ).get_vector();
+    volume += dot( a, cross( b, c ) );
+  }
+  return volume / 6;
+}
+
+// mode against no culling at all: only what is seen through the openings
+// of the mesh may differ
+template <class S>
+int test_mesh( const std::string & name, const Shape & shape, CullMode mode, int rasterizer )
+{
+  unsigned long culled = 0, none_culled = 0;
+  BasicFramebuffer<S> culled_fb = render<S>( shape, mode, rasterizer, culled );
+  BasicFramebuffer<S> full_fb = render<S>( shape, CullMode::None, rasterizer, none_culled );
+
+  int covered { 0 };
+  int differ { 0 };
+  for( int y = 0; y < full_fb.get_height(); y++ )
+    for( int x = 0; x < full_fb.get_width(); x++ )
+      if( !ColorBuffer::same_color( full_fb.get_pixel( x, y ), full_fb.get_clear_color() ) )
+      {
+        ++covered;
+        if( culled_fb.get_depth( x, y ) != full_fb.get_depth( x, y ) )
+          ++differ;
+      }
+  std::cout << name << ": " << culled << " faces culled, depth differs on " << differ << " of " << covered << " pixels" << std::endl;
+
+  TestVector test_vec
+    { { "about half the faces culled", 3 * culled > shape.face_count() && 3 * culled < 2 * shape.face_count() }
+    , { "something drawn", covered > 1000 }
+    , { "same depth buffer", 100 * differ < covered } };
+
+  return run_tests( name, test_vec );
+}
+
+// the faces of shape wound the other way
+Shape flipped( const Shape & shape )
+{
+  std::vector<Vertex> vertices;
+  for( size_t i = 0; i < shape.vertex_count(); i++ )
+    vertices.push_back( shape.get_vertex( i ) );
+  std::vector<Face> faces;
+  for( size_t f = 0; f < shape.face_count(); f++ )
+  {
+    Face face = shape.get_face( f );
+    faces.push_back( Face( face.get_v0(), face.get_v2(), face.get_v1(), face.get_color() ) );
+  }
+  return Shape( "flipped", vertices, faces );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    Shape shape = two_triangles();
+    failures += test_mode<float>( "back, scanline", shape, CullMode::Back, 1, 0 );
+    failures += test_mode<float>( "front, scanline", shape, CullMode::Front, 1, 0 );
+    failures += test_mode<float>( "none, scanline", shape, CullMode::None, 1, 0 );
+    failures += test_mode<float>( "back, half-space", shape, CullMode::Back, 1, 1 );
+    failures += test_mode<float>( "front, tiled", shape, CullMode::Front, 1, 2 );
+    failures += test_mode<double>( "back, scanline in double", shape, CullMode::Back, 1, 0 );
+
+    // the default mode suits meshes wound counter-clockwise, as teapot.obj
+    // is; one wound the other way needs Front
+    Shape teapot = load_obj( "teapot.obj" );
+    TestVector winding_vec
+      { { "teapot.obj wound counter-clockwise", signed_volume( teapot ) > 0 }
+      , { "Back by default", Object( teapot, { 0, 0, 0 }, { 0, 0, 0 }, { 1, 1, 1 } ).get_cull_mode() == CullMode::Back } };
+    failures += run_tests( "teapot winding", winding_vec );
+    failures += test_mesh<float>( "teapot, scanline", teapot, CullMode::Back, 0 );
+    failures += test_mesh<float>( "teapot, half-space", teapot, CullMode::Back, 1 );
+    failures += test_mesh<float>( "teapot, tiled", teapot, CullMode::Back, 2 );
+    failures += test_mesh<double>( "teapot in double", teapot, CullMode::Back, 0 );
+    failures += test_mesh<float>( "clockwise teapot", flipped( teapot ), CullMode::Front, 0 );
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,146 @@
+//
+// File       : test_expr.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the Vector and Matrix expressions, and times fused expressions
+// against the same computations with one temporary per operator.
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "matrix.h"
+
+using namespace aline;
+
+int test_vector_expressions()
+{
+  Vec3r u { 1, 2, 3 };
+  Vec3r v { -4, .5, 6 };
+  Vec3r w { .25, 7, -2 };
+
+  Vec3r a = u + v * 2.0 - w;
+  Vec3r b = 2.0 * ( u - v ) / 4.0;
+  Vec3r c = u;
+  c = w - c;
+
+  TestVector test_vec
+    { { "u + v * 2.0 - w", a == Vec3r { 1 - 8 - .25, 2 + 1 - 7, 3 + 12 + 2 } }
+    , { "2.0 * ( u - v ) / 4.0", b == Vec3r { 2.5, .75, -1.5 } }
+    , { "c = w - c", c == Vec3r { -.75, 5, -5 } }
+    , { "dot( u + v, w )", dot( u + v, w ) == dot( Vec3r( u + v ), w ) }
+    , { "norm( -u )", norm( -u ) == norm( u ) } };
+
+  return run_tests( "Vector expressions", test_vec );
+}
+
+int test_matrix_expressions()
+{
+  Mat44r t = translation( 1.0, 2.0, 3.0 );
+  Mat44r r = rotation_y( .5 );
+  Mat44r s = scaling( 2.0, 2.0, 2.0 );
+
+  Mat44r tr = t * r;
+  Mat44r trs = tr * s;
+  Mat44r blend = .25 * t + .75 * r;
+  Mat44r blend_ref;
+  for( int i = 0; i < 4; i++ )
+    for( int j = 0; j < 4; j++ )
+      blend_ref[i][j] = .25 * t[i][j] + .75 * r[i][j];
+
+  // products and transpositions read the matrix they are assigned to
+  Mat44r m = t;
+  m = m * r;
+  Mat44r n = t;
+  n = transpose( n );
+
+  TestVector test_vec
+    { { "t * r * s", t * r * s == trs }
+    , { "( t * r ) * s == t * ( r * s )", nearly_equal( ( t * r ) * s, t * ( r * s ) ) }
+    , { ".25 * t + .75 * r", blend == blend_ref }
+    , { "m = m * r", m == tr }
+    , { "n = transpose( n )", n[0][3] == 0 && n[3][0] == 1 && n[3][2] == 3 }
+    , { "( t - t ) * r == 0", ( t - t ) * r == Mat44r() }
+    , { "( t + r ) * v", nearly_equal( ( t + r ) * Vec4r { 1, 1, 1, 1 }, t * Vec4r { 1, 1, 1, 1 } + r * Vec4r { 1, 1, 1, 1 } ) } };
+
+  return run_tests( "Matrix expressions", test_vec );
+}
+
+// elapsed nanoseconds per iteration of f
+template <class F>
+double time_ns( int iterations, F f )
+{
+  auto start = std::chrono::steady_clock::now();
+  for( int i = 0; i < iterations; i++ )
+    f( i );
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>( end - start ).count() / iterations;
+}
+
+// interpolation between two object transforms (t = translation * rotation *
+// scale), as for keyframed animation: with expressions the blend is one loop
+// over the 16 elements, with temporaries it builds three matrices
+int benchmark()
+{
+  const int iterations = 1000000;
+  const Mat44r a = translation( 40.0, 0.0, 3000.0 ) * rotation_y( .3 ) * scaling( 1.0, 1.0, 1.0 );
+  const Mat44r b = translation( 45.0, 5.0, 2900.0 ) * rotation_y( .9 ) * scaling( 2.0, 2.0, 2.0 );
+  std::vector<real> weights;
+  for( int i = 0; i < 256; i++ )
+    weights.push_back( i / 255.0 );
+
+  real fused_sum = 0;
+  double fused = time_ns( iterations, [&]( int i ) {
+    real w = weights[i & 255];
+    Mat44r m = ( 1 - w ) * a + w * b;
+    fused_sum += m[0][0] + m[2][3];
+  } );
+
+  real temporaries_sum = 0;
+  double temporaries = time_ns( iterations, [&]( int i ) {
+    real w = weights[i & 255];
+    Mat44r wa = Mat44r( ( 1 - w ) * a );
+    Mat44r wb = Mat44r( w * b );
+    Mat44r m = Mat44r( wa + wb );
+    temporaries_sum += m[0][0] + m[2][3];
+  } );
+
+  // the transform chain of Object::transform, products are not fused
+  real chain_sum = 0;
+  double chain = time_ns( iterations, [&]( int i ) {
+    Mat44r m = translation( 40.0, 0.0, 3000.0 + i ) * rotation_y( weights[i & 255] ) * scaling( 1.0, 1.0, 1.0 );
+    chain_sum += m[0][0] + m[2][3];
+  } );
+
+  std::cout << "blend of two transforms: " << fused << " ns fused, "
+            << temporaries << " ns with temporaries" << std::endl;
+  std::cout << "translation * rotation * scale: " << chain << " ns" << std::endl;
+
+  TestVector test_vec
+    { { "same blends", fused_sum == temporaries_sum }
+    , { "chain computed", chain_sum != 0 } };
+
+  return run_tests( "expression benchmark", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_vector_expressions();
+    failures += test_matrix_expressions();
+    failures += benchmark();
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -7,6 +7,7 @@
 //
 
 #include <limits>       // std::numeric_limits<T>::epsilon()
+#include <type_traits>  // std::is_trivially_copyable
 #include <vector>       // std::vector
 #include "unit_test.h"
 #include "matrix.h"
@@ -388,6 +389,94 @@ int test_inverse()
   return run_tests( "inverse( Matrix )", test_vec );
 }
 
+int test_det()
+{
+  Mat33i a { {2,3,8},{6,0,-3},{-1,3,2} };
+  Mat33r b { {.5,0,0},{0,.5,0},{0,0,3} };
+  Mat44r c { {0,2,0,0},{1,0,0,0},{0,0,.5,0},{0,0,0,4} };
+
+  TestVector test_vec
+    { { "det( a ) == 135", det( a ) == 135 }
+    , { "det( b ) == .75", det( b ) == .75 }
+    , { "det( c ) == -4", det( c ) == -4 } };
+
+  return run_tests( "det( Matrix )", test_vec );
+}
+
+int test_inverse_pivoting()
+{
+  // a zero on the diagonal needs a row swap
+  Mat44r a { {0,2,0,0},{1,0,0,0},{0,0,.5,0},{0,0,0,4} };
+  Mat44r b { {0,1,0,0},{.5,0,0,0},{0,0,2,0},{0,0,0,.25} };
+  Mat44r c { {1,2,3,4},{2,4,6,8},{0,1,0,1},{1,0,0,1} };
+
+  TestVector test_vec
+    { { "inverse( a ) == b", inverse( a ) == b }
+    , { "isnan( inverse( c ) )", isnan( inverse( c ) ) } };
+
+  return run_tests( "inverse( Mat44r )", test_vec );
+}
+
+int test_affine_inverse()
+{
+  // rotation by 90 degrees around z then translation
+  Mat44r r { {0,-1,0,5},{1,0,0,-2},{0,0,1,3},{0,0,0,1} };
+  // scale, rotation and translation
+  Mat44r s { {0,-2,0,5},{.5,0,0,-2},{0,0,4,3},{0,0,0,1} };
+  Mat44r id { {1,0,0,0},{0,1,0,0},{0,0,1,0},{0,0,0,1} };
+
+  TestVector test_vec
+    { { "rigid_inverse( r ) == inverse( r )", rigid_inverse( r ) == inverse( r ) }
+    , { "r * rigid_inverse( r ) == id", r * rigid_inverse( r ) == id }
+    , { "affine_inverse( s ) == inverse( s )", affine_inverse( s ) == inverse( s ) }
+    , { "s * affine_inverse( s ) == id", s * affine_inverse( s ) == id } };
+
+  return run_tests( "rigid_inverse( Mat44r ), affine_inverse( Mat44r )", test_vec );
+}
+
+// built by the compiler
+constexpr Mat44r moved = translation( 1.0, 2.0, 3.0 ) * scaling( 2.0, 2.0, 2.0 );
+static_assert( moved * Vec4r { 1, 1, 1, 1 } == Vec4r { 3, 4, 5, 1 }, "constexpr transform" );
+static_assert( affine_inverse( moved ) * moved == identity<real,4>(), "constexpr affine_inverse" );
+static_assert( inverse( translation( 1.0, 2.0, 3.0 ) )[0][3] == -1 && inverse( moved ) * moved == identity<real,4>(), "constexpr inverse" );
+static_assert( det( Mat33i { {2,3,8},{6,0,-3},{-1,3,2} } ) == 135, "constexpr det" );
+static_assert( transpose( Mat33i { {1,2,3},{4,5,6},{7,8,9} } ) == Mat33i { {1,4,7},{2,5,8},{3,6,9} }, "constexpr transpose" );
+
+int test_factories()
+{
+  constexpr Mat44r rx = rotation_x( 0.5 );
+  constexpr Mat44r ry = rotation_y( -2.0 );
+  constexpr Mat44r rz = rotation_z( 4.0 );
+  Mat44r rx_ref { {1,0,0,0}, {0,std::cos(0.5),-std::sin(0.5),0}, {0,std::sin(0.5),std::cos(0.5),0}, {0,0,0,1} };
+  Mat44r ry_ref { {std::cos(-2.0),0,std::sin(-2.0),0}, {0,1,0,0}, {-std::sin(-2.0),0,std::cos(-2.0),0}, {0,0,0,1} };
+  Mat44r rz_ref { {std::cos(4.0),-std::sin(4.0),0,0}, {std::sin(4.0),std::cos(4.0),0,0}, {0,0,1,0}, {0,0,0,1} };
+  constexpr Vec4r y = rotation_z( M_PI / 2 ) * Vec4r { 1, 0, 0, 1 };
+
+  TestVector test_vec
+    { { "rotation_x( 0.5 )", nearly_equal( rx, rx_ref ) }
+    , { "rotation_y( -2.0 )", nearly_equal( ry, ry_ref ) }
+    , { "rotation_z( 4.0 )", nearly_equal( rz, rz_ref ) }
+    , { "rotation_z( pi / 2 ) * x == y", std::abs( y[0] ) < 1e-15 && std::abs( y[1] - 1 ) < 1e-15 }
+    , { "identity<int,3>()", identity<int,3>() == Mat33i { {1,0,0},{0,1,0},{0,0,1} } } };
+
+  return run_tests( "constexpr factories", test_vec );
+}
+
+// copies are plain memcpy, in particular the rows returned by operator[]
+static_assert( std::is_trivially_copyable<Mat44r>::value, "Mat44r is not trivially copyable" );
+static_assert( std::is_trivially_copyable<Mat33i>::value, "Mat33i is not trivially copyable" );
+
+int test_row_reference()
+{
+  const Mat33i a { {1,2,3},{4,5,6},{7,8,9} };
+
+  TestVector test_vec
+    { { "&a[1] == &a[0] + 1", &a[1] == &a[0] + 1 }
+    , { "&a[2][0] == a.data() + 6", &a[2][0] == a.data() + 6 } };
+
+  return run_tests( "operator[]( Matrix ) const", test_vec );
+}
+
 int main()
 {
     int failures { 0 };
@@ -409,6 +498,11 @@ int main()
     failures += test_to_string();
     failures += test_transpose();
     failures += test_inverse();
+    failures += test_det();
+    failures += test_inverse_pivoting();
+    failures += test_affine_inverse();
+    failures += test_row_reference();
+    failures += test_factories();
 
     failures += test_operator_output();
 
@@ -0,0 +1,304 @@
+//
+// File       : test_mesh_cache.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the binary mesh cache: writing, zero-copy mapping, invalidation
+// when the OBJ file changes, corrupted caches and indices, and compares the load time
+// of a warm cache with parsing.
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <cstdio>       // std::remove
+#include <cstdint>      // uintptr_t
+#include <fstream>      // std::ofstream, std::fstream
+#include <string>       // std::string
+#include <sys/stat.h>   // utimensat
+#include <fcntl.h>      // AT_FDCWD
+#include "unit_test.h"
+#include "mesh_cache.h"
+
+using namespace aline;
+
+const char * OBJ_FILE = "test_mesh_cache.obj";
+const char * GRID_FILE = "test_mesh_cache_grid.obj";
+
+void write_text( const char * file_name, const std::string & text )
+{
+  std::ofstream out( file_name );
+  out << text;
+}
+
+// moves the modification time of a file by seconds
+void shift_mtime( const char * file_name, long seconds )
+{
+  SourceStamp stamp = stat_source( file_name );
+  struct timespec times[2];
+  times[0].tv_sec = stamp.mtime / 1000000000 + seconds;
+  times[0].tv_nsec = stamp.mtime % 1000000000;
+  times[1] = times[0];
+  utimensat( AT_FDCWD, file_name, times, 0 );
+}
+
+bool same_stream( View<float> a, View<float> b )
+{
+  if( a.size() != b.size() )
+    return false;
+  for( size_t i = 0; i < a.size(); i++ )
+    if( a[i] != b[i] )
+      return false;
+  return true;
+}
+
+bool same_shape( const Shape & a, const Shape & b )
+{
+  if( a.vertex_count() != b.vertex_count() || a.face_count() != b.face_count() )
+    return false;
+  const VertexAttributes & p = a.get_attributes();
+  const VertexAttributes & q = b.get_attributes();
+  if( !same_stream( p.nx, q.nx ) || !same_stream( p.ny, q.ny ) || !same_stream( p.nz, q.nz )
+      || !same_stream( p.u, q.u ) || !same_stream( p.v, q.v ) )
+    return false;
+  for( size_t i = 0; i < a.vertex_count(); i++ )
+    if( a.get_x()[i] != b.get_x()[i] || a.get_y()[i] != b.get_y()[i] || a.get_z()[i] != b.get_z()[i] )
+      return false;
+  for( size_t i = 0; i < 3 * a.face_count(); i++ )
+    if( a.get_indices()[i] != b.get_indices()[i] )
+      return false;
+  for( size_t i = 0; i < a.face_count(); i++ )
+    if( a.get_colors()[i].r != b.get_colors()[i].r || a.get_colors()[i].g != b.get_colors()[i].g || a.get_colors()[i].b != b.get_colors()[i].b )
+      return false;
+  return a.get_bounds().min == b.get_bounds().min && a.get_bounds().max == b.get_bounds().max
+      && a.get_bounds().radius == b.get_bounds().radius;
+}
+
+const std::string TETRAHEDRON =
+  "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\nf 1 3 2\nf 1 2 4\nf 1 4 3\nf 2 3 4\n";
+
+// a pyramid with texture coordinates on every corner and normals on the
+// sides only
+const std::string PYRAMID =
+  "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 0.5 1\n"
+  "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvt 0.5 0.5\n"
+  "vn 0 -1 0.5\nvn 1 0 0.5\nvn 0 1 0.5\nvn -1 0 0.5\n"
+  "f 4/4 3/3 2/2 1/1\n"
+  "f 1/1/1 2/2/1 5/5/1\nf 2/2/2 3/3/2 5/5/2\nf 3/3/3 4/4/3 5/5/3\nf 4/4/4 1/1/4 5/5/4\n";
+
+int test_cache()
+{
+  const std::string cache = mesh_cache_path( OBJ_FILE );
+  std::remove( cache.c_str() );
+  write_text( OBJ_FILE, TETRAHEDRON );
+  bool missing = !mesh_cache_valid( OBJ_FILE );
+
+  Shape parsed = load_mesh( OBJ_FILE );
+  bool written = mesh_cache_valid( OBJ_FILE );
+  Shape mapped = load_mesh( OBJ_FILE );
+  uintptr_t x = reinterpret_cast<uintptr_t>( mapped.get_x().data() );
+  uintptr_t indices = reinterpret_cast<uintptr_t>( mapped.get_indices().data() );
+
+  // the mapping lives as long as a copy of the shape does
+  Shape * copy = nullptr;
+  {
+    Shape first = open_mesh( cache.c_str(), OBJ_FILE );
+    copy = new Shape( first );
+  }
+  bool copy_alive = same_shape( *copy, parsed );
+  delete copy;
+
+  // the attribute streams follow the others in the file
+  write_text( OBJ_FILE, PYRAMID );
+  Shape textured = load_mesh( OBJ_FILE );
+  Shape textured_mapped = open_mesh( cache.c_str(), OBJ_FILE );
+  bool attributes = textured.has_normals() && textured.has_uvs() && same_shape( textured_mapped, textured )
+                 && textured_mapped.get_attributes().v.data() != textured.get_attributes().v.data();
+
+  TestVector test_vec
+    { { "no cache at first", missing }
+    , { "written on first load", written }
+    , { "same shape from the cache", same_shape( mapped, parsed ) && mapped.get_name() == OBJ_FILE }
+    , { "streams used in place", x % 4096 == mesh_align( sizeof( MeshHeader ) ) && indices % MESH_ALIGNMENT == 0 }
+    , { "copies keep the mapping", copy_alive }
+    , { "normals and texture coordinates", attributes } };
+
+  return run_tests( "mesh cache", test_vec );
+}
+
+int test_invalidation()
+{
+  const std::string cache = mesh_cache_path( OBJ_FILE );
+  write_text( OBJ_FILE, TETRAHEDRON );
+  load_mesh( OBJ_FILE );
+
+  // same content, newer file: the hash keeps the cache, which takes the time
+  shift_mtime( OBJ_FILE, 10 );
+  bool touched = mesh_cache_valid( OBJ_FILE );
+  MeshHeader header;
+  read_mesh_header( cache.c_str(), header );
+  bool restamped = header.source.mtime == stat_source( OBJ_FILE ).mtime;
+
+  // same size, another content
+  std::string moved = TETRAHEDRON;
+  moved[ 10 ] = '2';
+  write_text( OBJ_FILE, moved );
+  shift_mtime( OBJ_FILE, 20 );
+  bool edited = !mesh_cache_valid( OBJ_FILE );
+  bool reloaded = load_mesh( OBJ_FILE ).get_x()[1] == 2 && mesh_cache_valid( OBJ_FILE );
+
+  // another size, even with the time of the cached source
+  read_mesh_header( cache.c_str(), header );
+  write_text( OBJ_FILE, TETRAHEDRON + "v 5 5 5\n" );
+  struct timespec times[2];
+  times[0].tv_sec = header.source.mtime / 1000000000;
+  times[0].tv_nsec = header.source.mtime % 1000000000;
+  times[1] = times[0];
+  utimensat( AT_FDCWD, OBJ_FILE, times, 0 );
+  bool resized = !mesh_cache_valid( OBJ_FILE );
+  bool grown = load_mesh( OBJ_FILE ).vertex_count() == 5;
+
+  TestVector test_vec
+    { { "touched source keeps the cache", touched }
+    , { "cache takes the new time", restamped }
+    , { "edited source invalidates", edited }
+    , { "rebuilt from the edited source", reloaded }
+    , { "resized source invalidates", resized }
+    , { "rebuilt from the resized source", grown } };
+
+  return run_tests( "mesh cache invalidation", test_vec );
+}
+
+// overwrites one byte of a file
+void corrupt( const std::string & file_name, uint64_t offset )
+{
+  std::fstream file( file_name, std::ios::in | std::ios::out | std::ios::binary );
+  file.seekp( offset );
+  file.put( 0x42 );
+}
+
+bool rejected( const std::string & cache, bool verify )
+{
+  try
+  {
+    open_mesh( cache.c_str(), OBJ_FILE, verify );
+  }
+  catch( const std::runtime_error & )
+  {
+    return true;
+  }
+  return false;
+}
+
+int test_corruption()
+{
+  const std::string cache = mesh_cache_path( OBJ_FILE );
+  write_text( OBJ_FILE, TETRAHEDRON );
+  Shape parsed = load_mesh( OBJ_FILE );
+
+  // one byte of the x stream, only seen by the checksum
+  MeshHeader header;
+  read_mesh_header( cache.c_str(), header );
+  corrupt( cache, header.x_offset + 1 );
+  bool checksum = rejected( cache, true );
+  bool unverified = !rejected( cache, false );
+
+  // an index past the vertices, always checked
+  corrupt( cache, header.index_offset + 3 );
+  bool index = rejected( cache, false );
+  bool recovered = same_shape( load_mesh( OBJ_FILE ), parsed );
+  bool rewritten = same_shape( open_mesh( cache.c_str(), OBJ_FILE, true ), parsed );
+
+  // not a mesh file at all
+  write_text( cache.c_str(), "v 0 0 0\n" );
+  bool foreign = !read_mesh_header( cache.c_str(), header ) && !mesh_cache_valid( OBJ_FILE );
+  bool replaced = same_shape( load_mesh( OBJ_FILE ), parsed ) && mesh_cache_valid( OBJ_FILE );
+
+  // a shape with an index past its vertices is never written
+  AlignedVector<float> xs { 0, 1, 0 }, ys { 0, 0, 1 }, zs { 0, 0, 0 };
+  AlignedVector<uint> indices { 0, 1, 3 };
+  Shape bad( "bad", std::move( xs ), std::move( ys ), std::move( zs ), std::move( indices ), { minwin::WHITE } );
+  bool refused = false;
+  try
+  {
+    write_mesh( bad, cache.c_str(), stat_source( OBJ_FILE ) );
+  }
+  catch( const std::invalid_argument & )
+  {
+    refused = true;
+  }
+
+  TestVector test_vec
+    { { "checksum mismatch rejected when verified", checksum }
+    , { "and mapped as is otherwise", unverified }
+    , { "index out of range rejected", index }
+    , { "load_mesh parses instead", recovered }
+    , { "and rewrites the cache", rewritten }
+    , { "foreign file rejected", foreign }
+    , { "and replaced", replaced }
+    , { "bad indices not written", refused && mesh_cache_valid( OBJ_FILE ) } };
+
+  return run_tests( "corrupted mesh cache", test_vec );
+}
+
+// 400 x 400 vertex grid, two triangles per cell
+void write_grid()
+{
+  std::ofstream out( GRID_FILE );
+  const int n = 400;
+  for( int i = 0; i < n; i++ )
+    for( int j = 0; j < n; j++ )
+      out << "v " << i * 0.731 << " " << j * -1.377 << " " << ( i * j % 97 ) * 0.0125 << "\n";
+  for( int i = 0; i + 1 < n; i++ )
+    for( int j = 0; j + 1 < n; j++ )
+    {
+      int v = i * n + j + 1;
+      out << "f " << v << " " << v + 1 << " " << v + n << "\n";
+      out << "f " << v + 1 << " " << v + n + 1 << " " << v + n << "\n";
+    }
+}
+
+int test_warm_start()
+{
+  write_grid();
+  auto start = std::chrono::steady_clock::now();
+  Shape parsed = build_mesh_cache( GRID_FILE );
+  auto built = std::chrono::steady_clock::now();
+  Shape mapped = load_mesh( GRID_FILE );
+  auto end = std::chrono::steady_clock::now();
+
+  double parse_ms = std::chrono::duration<double, std::milli>( built - start ).count();
+  double map_ms = std::chrono::duration<double, std::milli>( end - built ).count();
+  std::cout << GRID_FILE << ": " << parsed.face_count() << " faces, " << parse_ms << " ms parsing and writing the cache, "
+            << map_ms << " ms from the warm cache" << std::endl;
+
+  TestVector test_vec
+    { { "same shape", same_shape( mapped, parsed ) }
+    , { "faster than parsing", map_ms < parse_ms } };
+
+  std::remove( mesh_cache_path( GRID_FILE ).c_str() );
+  std::remove( GRID_FILE );
+  return run_tests( "warm start", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_cache();
+    failures += test_invalidation();
+    failures += test_corruption();
+    failures += test_warm_start();
+    std::remove( mesh_cache_path( OBJ_FILE ).c_str() );
+    std::remove( OBJ_FILE );
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,366 @@
+//
+// File       : test_obj_loader.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the memory mapped OBJ loader against the getline / istringstream
+// loader it replaced, the face syntax the latter ignored (n-gons, texture
+// coordinates, normals, negative indices) and the welding of corners into
+// vertices, and measures the load throughput of both, the mapped
+// one on one thread and on all cores.
+//
+// usage: test_obj_loader [file.obj]
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <cstdio>       // std::remove
+#include <cstdlib>      // std::strtod
+#include <cstring>      // std::strlen
+#include <fstream>      // std::ifstream, std::ofstream
+#include <sstream>      // std::istringstream
+#include <thread>       // std::thread::hardware_concurrency
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "obj_loader.h"
+
+using namespace aline;
+
+const char * GRID_FILE = "test_obj_loader.obj";
+
+// the former Scene::load_obj_file
+Shape load_reference( const char * file_name )
+{
+  std::ifstream objFile( file_name );
+  AlignedVector<float> xs, ys, zs;
+  AlignedVector<uint> indices;
+  std::vector<minwin::Color> colors;
+  std::string line;
+  while( std::getline( objFile, line ) )
+  {
+    std::istringstream lineStream( line );
+    std::string type;
+    lineStream >> type;
+    if( type == "v" )
+    {
+      real x, y, z;
+      lineStream >> x >> y >> z;
+      xs.push_back( x );
+      ys.push_back( y );
+      zs.push_back( z );
+    }
+    else if( type == "f" )
+    {
+      uint v1, v2, v3;
+      lineStream >> v1 >> v2 >> v3;
+      indices.push_back( v1 - 1 );
+      indices.push_back( v2 - 1 );
+      indices.push_back( v3 - 1 );
+      colors.push_back( minwin::WHITE );
+    }
+  }
+  return Shape( file_name, std::move( xs ), std::move( ys ), std::move( zs ), std::move( indices ), std::move( colors ) );
+}
+
+bool same_stream( View<float> a, View<float> b )
+{
+  if( a.size() != b.size() )
+    return false;
+  for( size_t i = 0; i < a.size(); i++ )
+    if( a[i] != b[i] )
+      return false;
+  return true;
+}
+
+bool same_shape( const Shape & a, const Shape & b )
+{
+  if( a.vertex_count() != b.vertex_count() || a.face_count() != b.face_count() )
+    return false;
+  const VertexAttributes & p = a.get_attributes();
+  const VertexAttributes & q = b.get_attributes();
+  if( !same_stream( p.nx, q.nx ) || !same_stream( p.ny, q.ny ) || !same_stream( p.nz, q.nz )
+      || !same_stream( p.u, q.u ) || !same_stream( p.v, q.v ) )
+    return false;
+  for( size_t i = 0; i < a.vertex_count(); i++ )
+    if( a.get_x()[i] != b.get_x()[i] || a.get_y()[i] != b.get_y()[i] || a.get_z()[i] != b.get_z()[i] )
+      return false;
+  for( size_t i = 0; i < 3 * a.face_count(); i++ )
+    if( a.get_indices()[i] != b.get_indices()[i] )
+      return false;
+  return true;
+}
+
+bool parses_as_strtod( const char * text )
+{
+  double value = 0;
+  const char * end = obj::parse_real( text, text + std::strlen( text ), value );
+  char * expected_end;
+  double expected = std::strtod( text, &expected_end );
+  return end == expected_end && value == expected;
+}
+
+bool throws( const char * text )
+{
+  try
+  {
+    parse_obj( "bad", text, text + std::strlen( text ) );
+  }
+  catch( const std::runtime_error & )
+  {
+    return true;
+  }
+  return false;
+}
+
+int test_numbers()
+{
+  double value = 0;
+  const char * text = "abc";
+  long index = 0;
+  const char * digits = "-12/4";
+  const char * huge = "123456789012345678901234567890 ";
+  long saturated = 0;
+
+  TestVector test_vec
+    { { "integer", parses_as_strtod( "42" ) }
+    , { "negative fraction", parses_as_strtod( "-2.5" ) }
+    , { "exponent", parses_as_strtod( "1e3" ) && parses_as_strtod( "3.25E-2" ) && parses_as_strtod( "-7.0e+1" ) }
+    , { "no integer part", parses_as_strtod( ".5" ) && parses_as_strtod( "+7." ) }
+    , { "teapot coordinates", parses_as_strtod( "1.38137" ) && parses_as_strtod( "-0.00216411" ) && parses_as_strtod( "2.4" ) }
+    , { "long mantissa", parses_as_strtod( "0.1000000000000000055511151231257827" ) && parses_as_strtod( "123456789.123456789" ) }
+    , { "tiny and huge", parses_as_strtod( "1e-30" ) && parses_as_strtod( "6.02214076e23" ) }
+    , { "stops before the next token", parses_as_strtod( "1.5 2.5" ) && parses_as_strtod( "1e" ) }
+    , { "not a number", obj::parse_real( text, text + 3, value ) == text }
+    , { "index before a slash", obj::parse_int( digits, digits + 5, index ) == digits + 3 && index == -12 }
+    , { "huge index saturated", obj::parse_int( huge, huge + 31, saturated ) == huge + 30 && saturated == obj::INDEX_LIMIT } };
+
+  return run_tests( "number parsing", test_vec );
+}
+
+int test_parse()
+{
+  const char * text =
+    "# comment\r\n"
+    "o quad\r\n"
+    "v 0 0 0\r\n"
+    "v 1 0 0\r\n"
+    "vt 0.5 0.5\r\n"
+    "vn 0 0 1\r\n"
+    "  v 1 1 0\r\n"
+    "v 0 1 -2.5e1\r\n"
+    "f 1/1/1 2/1/1 3/1/1\r\n"
+    "f 1//1 3//1 4//1";
+  Shape shape = parse_obj( "quad", text, text + std::strlen( text ) );
+  const VertexAttributes & attributes = shape.get_attributes();
+
+  // the corners of the second face have no texture coordinate, unlike the
+  // ones of the first face: none of them is welded with another
+  TestVector test_vec
+    { { "vertex count", shape.vertex_count() == 6 }
+    , { "face count", shape.face_count() == 2 }
+    , { "coordinates", shape.get_y()[2] == 1 && shape.get_z()[5] == -25 }
+    , { "indices", shape.get_indices()[3] == 3 && shape.get_indices()[4] == 4 && shape.get_indices()[5] == 5 }
+    , { "normals", shape.has_normals() && attributes.nz[0] == 1 && attributes.nz[5] == 1 && attributes.nx[3] == 0 }
+    , { "texture coordinates", shape.has_uvs() && attributes.u[2] == 0.5f && attributes.v[3] == 0 }
+    , { "bounds", shape.get_bounds().min[2] == -25 && shape.get_bounds().max[0] == 1 }
+    , { "bad coordinate", throws( "v 1 x 2\n" ) }
+    , { "index out of range", throws( "v 0 0 0\nf 1 2 1\n" ) }
+    , { "index zero", throws( "v 0 0 0\nf 0 1 1\n" ) }
+    , { "huge index", throws( "v 0 0 0\nf 1 1 123456789012345678901234567890\n" )
+                      && throws( "v 0 0 0\nf 1 -123456789012345678901234567890 1\n" )
+                      && throws( "v 0 0 0\nvt 0 0\nf 1/123456789012345678901234567890 1/1 1/1\n" ) }
+    , { "negative index out of range", throws( "v 0 0 0\nf -1 -2 -1\n" ) }
+    , { "normal out of range", throws( "v 0 0 0\nvn 0 0 1\nf 1//1 1//2 1//1\n" ) }
+    , { "two vertex face", throws( "v 0 0 0\nv 1 0 0\nf 1 2\n" ) }
+    , { "bad index", throws( "v 0 0 0\nf 1 1/x 1\n" ) } };
+
+  return run_tests( "parse_obj", test_vec );
+}
+
+bool has_indices( const Shape & shape, const std::vector<uint> & expected )
+{
+  if( shape.get_indices().size() != expected.size() )
+    return false;
+  for( size_t i = 0; i < expected.size(); i++ )
+    if( shape.get_indices()[i] != expected[i] )
+      return false;
+  return true;
+}
+
+int test_faces()
+{
+  const char * text =
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 1.5 0\n"
+    "f 1 2 3 4 5\n"
+    "f -5 -4 -3 -2 # quad\n"
+    "f 1/ 2/ 3/\n";
+  Shape shape = parse_obj( "polygons", text, text + std::strlen( text ) );
+
+  TestVector test_vec
+    { { "positions as vertices", shape.vertex_count() == 5 && !shape.has_normals() && !shape.has_uvs() }
+    , { "fans of triangles", has_indices( shape, { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 1, 2, 0, 2, 3, 0, 1, 2 } ) }
+    , { "one color per triangle", shape.get_colors().size() == 6 } };
+
+  return run_tests( "n-gons and negative indices", test_vec );
+}
+
+// a unit cube of 8 positions and 6 normals, one quad per side: 24
+// distinct corners, each one position with the normal of its side
+int test_weld()
+{
+  const char * cube =
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+    "vn 0 0 -1\nvn 0 0 1\nvn 0 -1 0\nvn 0 1 0\nvn -1 0 0\nvn 1 0 0\n"
+    "f 1//1 4//1 3//1 2//1\nf 5//2 6//2 7//2 8//2\nf 1//3 2//3 6//3 5//3\n"
+    "f 4//4 8//4 7//4 3//4\nf 1//5 5//5 8//5 4//5\nf 2//6 3//6 7//6 6//6\n";
+  Shape shape = parse_obj( "cube", cube, cube + std::strlen( cube ) );
+  const VertexAttributes & normals = shape.get_attributes();
+
+  // every normal points away from the center of the cube
+  bool outwards = true;
+  for( size_t i = 0; i < shape.vertex_count(); i++ )
+    outwards = outwards && ( shape.get_x()[i] - 0.5f ) * normals.nx[i] + ( shape.get_y()[i] - 0.5f ) * normals.ny[i]
+                           + ( shape.get_z()[i] - 0.5f ) * normals.nz[i] > 0;
+
+  // the same position with two texture coordinates makes two vertices
+  const char * seam =
+    "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1 0\n"
+    "f 1/1 2/2 3/3\nf 1/1 3/3 4/4\nf 1/2 2/2 3/3\n";
+  Shape textured = parse_obj( "seam", seam, seam + std::strlen( seam ) );
+  const VertexAttributes & uvs = textured.get_attributes();
+
+  TestVector test_vec
+    { { "one vertex per distinct corner", shape.vertex_count() == 24 && shape.face_count() == 12 }
+    , { "normals of their side", shape.has_normals() && !shape.has_uvs() && outwards }
+    , { "shared corners welded", has_indices( textured, { 0, 1, 2, 0, 2, 3, 4, 1, 2 } ) }
+    , { "texture coordinates", textured.has_uvs() && !textured.has_normals() && uvs.u[1] == 1 && uvs.v[3] == 1 && uvs.u[4] == 1 } };
+
+  return run_tests( "corner welding", test_vec );
+}
+
+// the same text cut into chunks of a few lines, some of them empty, and
+// faces using elements of other chunks, by negative indices too
+int test_chunks()
+{
+  std::string text;
+  for( int i = 0; i < 40; i++ )
+  {
+    text += "v " + std::to_string( i ) + " " + std::to_string( -i ) + " 0.5\n";
+    text += "vt " + std::to_string( i * 0.025 ) + " 0.25\n";
+    text += "vn 0 0 " + std::to_string( i ) + "\n";
+    if( i >= 2 )
+      text += "f -1/-1/-1 -2/-2/-1 1/1/1\n";
+  }
+  text += "f 40/40 1/1/1 2/2 -3/-3/-2";
+  const char * begin = text.data();
+  const char * end = begin + text.size();
+  Shape whole = parse_obj( "whole", begin, end, 1 );
+
+  bool same = true;
+  for( size_t chunk_size : { 1, 7, 50, 333 } )
+    for( unsigned threads : { 2, 3, 16, 200 } )
+      same = same && same_shape( parse_obj( "chunks", begin, end, threads, chunk_size ), whole );
+
+  std::vector<const char *> bounds = obj::split_lines( begin, end, 10 );
+  bool on_lines = true;
+  for( size_t i = 1; i < bounds.size() - 1; i++ )
+    on_lines = on_lines && bounds[i] >= bounds[i - 1] && ( bounds[i] == end || bounds[i][-1] == '\n' );
+
+  std::string bad = text + "\nv 1 2 x\n";
+  bool thrown = false;
+  try
+  {
+    parse_obj( "bad", bad.data(), bad.data() + bad.size(), 8, 16 );
+  }
+  catch( const std::runtime_error & )
+  {
+    thrown = true;
+  }
+
+  TestVector test_vec
+    { { "whole", whole.vertex_count() == 79 && whole.face_count() == 40 }
+    , { "same shape for any chunking", same }
+    , { "chunks end on newlines", on_lines }
+    , { "errors of a worker are rethrown", thrown } };
+
+  return run_tests( "parse_obj in chunks", test_vec );
+}
+
+// 500 x 500 vertex grid, two triangles per cell
+void write_grid()
+{
+  std::ofstream out( GRID_FILE );
+  const int n = 500;
+  for( int i = 0; i < n; i++ )
+    for( int j = 0; j < n; j++ )
+      out << "v " << i * 0.731 << " " << j * -1.377 << " " << ( i * j % 97 ) * 0.0125 << "\n";
+  for( int i = 0; i + 1 < n; i++ )
+    for( int j = 0; j + 1 < n; j++ )
+    {
+      int v = i * n + j + 1;
+      out << "f " << v << " " << v + 1 << " " << v + n << "\n";
+      out << "f " << v + 1 << " " << v + n + 1 << " " << v + n << "\n";
+    }
+}
+
+template <class Load>
+double megabytes_per_second( Load load, const char * file_name, Shape & shape )
+{
+  MappedFile file( file_name );
+  auto start = std::chrono::steady_clock::now();
+  shape = load( file_name );
+  auto end = std::chrono::steady_clock::now();
+  return file.size() / 1e6 / std::chrono::duration<double>( end - start ).count();
+}
+
+int test_throughput( const char * file_name )
+{
+  Shape mapped = load_obj( file_name );
+  Shape single = load_obj( file_name, 1 );
+  Shape reference = load_reference( file_name );
+  double mapped_rate = megabytes_per_second( []( const char * f ) { return load_obj( f ); }, file_name, mapped );
+  double single_rate = megabytes_per_second( []( const char * f ) { return load_obj( f, 1 ); }, file_name, single );
+  double reference_rate = megabytes_per_second( load_reference, file_name, reference );
+
+  std::cout << file_name << ": " << mapped.vertex_count() << " vertices, " << mapped.face_count() << " faces, "
+            << mapped_rate << " MB/s mapped on " << std::thread::hardware_concurrency() << " threads, "
+            << single_rate << " MB/s on one, " << reference_rate << " MB/s with getline" << std::endl;
+
+  TestVector test_vec
+    { { "same shape as getline", same_shape( mapped, reference ) }
+    , { "same shape on one thread", same_shape( single, reference ) }
+    , { "something loaded", mapped.face_count() > 0 } };
+
+  return run_tests( std::string( "load_obj( " ) + file_name + " )", test_vec );
+}
+
+int main( int argc, char * argv[] )
+{
+    int failures { 0 };
+
+    failures += test_numbers();
+    failures += test_parse();
+    failures += test_faces();
+    failures += test_weld();
+    failures += test_chunks();
+    if( argc > 1 )
+        failures += test_throughput( argv[1] );
+    else
+    {
+        failures += test_throughput( "teapot.obj" );
+        write_grid();
+        failures += test_throughput( GRID_FILE );
+        std::remove( GRID_FILE );
+    }
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
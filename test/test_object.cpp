@@ -0,0 +1,134 @@
+//
+// File       : test_object.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the cached transforms of Object and Camera, and frustum culling.
+//
+
+#include <cmath>        // std::abs, std::sqrt
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "shape.h"
+
+using namespace aline;
+
+int test_object_cache()
+{
+  Shape shape( "empty", std::vector<Vertex>(), std::vector<Face>() );
+  Object o( shape, { 40, 0, 3000 }, { 10, 20, 30 }, { 1, 2, 1 } );
+
+  Mat44r first = o.transform();
+  Mat44r expected = translation( 40.0, 0.0, 3000.0 ) * to_matrix( o.get_rotation() ) * scaling( 1.0, 2.0, 1.0 );
+  unsigned long after_first = o.get_rebuilds();
+  o.transform();
+  unsigned long after_second = o.get_rebuilds();
+
+  o.set_translation( { 0, 5, 10 } );
+  Mat44r moved = o.transform();
+  unsigned long after_move = o.get_rebuilds();
+
+  o.rotate( from_axis_angle( Vec3r { 0, 1, 0 }, .5 ) );
+  o.set_scale( { 3, 3, 3 } );
+  Mat44r turned = o.transform();
+
+  TestVector test_vec
+    { { "transform() is T * R * S", nearly_equal( first, expected ) }
+    , { "built once", after_first == 1 && after_second == 1 }
+    , { "set_translation rebuilds", after_move == 2 && moved[1][3] == 5 && moved[2][3] == 10 }
+    , { "rotate and set_scale rebuild", nearly_equal( turned, translation( 0.0, 5.0, 10.0 ) * to_matrix( o.get_rotation() ) * scaling( 3.0, 3.0, 3.0 ) ) } };
+
+  return run_tests( "Object::transform cache", test_vec );
+}
+
+int test_model_view_cache()
+{
+  Shape shape( "empty", std::vector<Vertex>(), std::vector<Face>() );
+  Object o( shape, { 40, 0, 3000 }, { 0, 45, 0 }, { 1, 1, 1 } );
+  Camera camera( 1 );
+
+  unsigned long version = camera.get_version();
+  Mat44r mv = o.model_view( camera.transform(), camera.get_version() );
+  Mat44r expected = camera.transform() * o.transform();
+  unsigned long built = o.get_rebuilds();
+  o.model_view( camera.transform(), camera.get_version() );
+  camera.update();
+  bool idle = camera.get_version() == version && o.get_rebuilds() == built && camera.get_rebuilds() == 1;
+
+  camera.move_forward( 2 );
+  camera.update();
+  camera.stop_movement();
+  Mat44r moved = o.model_view( camera.transform(), camera.get_version() );
+
+  TestVector test_vec
+    { { "model_view is view * model", mv == expected }
+    , { "idle camera keeps the caches", idle }
+    , { "moving camera changes the version", camera.get_version() == version + 1 }
+    , { "model_view follows the camera", moved[2][3] == mv[2][3] - 2 && o.get_rebuilds() == built + 1 } };
+
+  return run_tests( "Object::model_view cache", test_vec );
+}
+
+// 20 x 20 x 20 cube centered on the origin
+Shape cube()
+{
+  std::vector<Vertex> vertices;
+  for( int i = 0; i < 8; i++ )
+    vertices.push_back( Vertex( { i & 1 ? 10. : -10., i & 2 ? 10. : -10., i & 4 ? 10. : -10. }, 1 ) );
+  std::vector<Face> faces { Face( 0, 1, 2, minwin::WHITE ), Face( 5, 6, 7, minwin::WHITE ) };
+  return Shape( "cube", vertices, faces );
+}
+
+int test_frustum()
+{
+  Shape shape = cube();
+  const Bounds & b = shape.get_bounds();
+
+  // the projection of Scene, in a 1366 x 768 window: at z = 3000 the view
+  // spans x in [-60, 145]
+  Mat44r projection { { 20000, 0, 400, 0 }, { 0, -20000, 400, 0 }, { 0, 0, 0, 1 }, { 0, 0, 1, 0 } };
+  Camera camera( 1 );
+  camera.update_frustum( projection, -1, -1, 1366, 768 );
+  const Frustum & frustum = camera.get_frustum();
+
+  auto visible = [&]( const Vec3r & translation, real scale ) {
+    Object o( shape, translation, { 0, 30, 0 }, { scale, scale, scale } );
+    return frustum.intersects( shape.get_bounds(), o.transform() );
+  };
+
+  TestVector test_vec
+    { { "bounding box", b.min == Vec3r { -10, -10, -10 } && b.max == Vec3r { 10, 10, 10 } }
+    , { "bounding sphere", b.center == Vec3r { 0, 0, 0 } && std::abs( b.radius - std::sqrt( 300. ) ) < 1e-12 }
+    , { "in front", visible( { 40, 0, 3000 }, 1 ) }
+    , { "behind", !visible( { 40, 0, -3000 }, 1 ) }
+    , { "across the near plane", visible( { 0, 0, 5 }, 1 ) }
+    , { "beyond the far plane", !visible( { 0, 0, 200000 }, 1 ) }
+    , { "left, the sphere still crosses", !visible( { -75, 0, 3000 }, 1 ) }
+    , { "across the left plane", visible( { -60, 0, 3000 }, 1 ) }
+    , { "right", !visible( { 200, 0, 3000 }, 1 ) }
+    , { "above", !visible( { 40, 150, 3000 }, 1 ) }
+    , { "scaled up into view", visible( { -200, 0, 3000 }, 20 ) } };
+
+  return run_tests( "Frustum::intersects", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_object_cache();
+    failures += test_model_view_cache();
+    failures += test_frustum();
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,123 @@
+//
+// File       : test_precision.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Renders an OBJ file (teapot.obj by default) with the float and the double
+// pipelines, compares the images, the depth buffers and the faces culled,
+// and times both.
+//
+// usage: test_precision [file.obj]
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <cmath>        // std::abs
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "scene.h"
+
+using namespace aline;
+
+const uint FRAMES = 50;
+
+// last image of a run: its colors, its depth buffer and the faces culled
+struct Frame
+{
+  std::vector<minwin::Color> colors;
+  std::vector<double> depth;
+  unsigned long culled = 0;
+};
+
+// renders FRAMES frames, returns the milliseconds per frame and the last frame
+template <class S>
+double render( char * file_name, int display, int rasterizer, Frame & frame )
+{
+  BasicScene<S> scene;
+  scene.initialise_headless( FRAMES );
+  scene.set_display( display );
+  scene.set_rasterizer( rasterizer );
+  char * argv[] = { nullptr, file_name };
+  scene.load_data( 2, argv );
+  scene.finish_loading();
+
+  auto start = std::chrono::steady_clock::now();
+  scene.run();
+  auto end = std::chrono::steady_clock::now();
+
+  const BasicFramebuffer<S> & fb = scene.get_framebuffer();
+  frame.colors.assign( fb.data(), fb.data() + fb.get_width() * fb.get_height() );
+  frame.depth.clear();
+  for( int y = 0; y < fb.get_height(); y++ )
+    for( int x = 0; x < fb.get_width(); x++ )
+      frame.depth.push_back( fb.get_depth( x, y ) );
+  frame.culled = scene.get_stats().triangles_culled;
+  return std::chrono::duration<double, std::milli>( end - start ).count() / FRAMES;
+}
+
+// the shape is drawn in one color, so a wrong z-test winner only shows in
+// the depth buffers: where both pipelines drew, 1/z must agree within
+// 0.1%, except on one pixel in a thousand (edges, depth ties). Float may
+// also move an edge by a pixel here and there, and decide differently for
+// faces seen almost edge-on, which culls them in one pipeline only: at
+// most 2% of the faces, whose edges are all a wireframe shows, hence its
+// looser bound on different pixels
+int compare( const std::string & name, char * file_name, int display, int rasterizer )
+{
+  Frame single;
+  Frame twice;
+  double float_ms = render<float>( file_name, display, rasterizer, single );
+  double double_ms = render<double>( file_name, display, rasterizer, twice );
+  const size_t faces = load_obj( file_name ).face_count();
+
+  size_t drawn = 0;
+  size_t different = 0;
+  size_t deeper = 0;
+  for( size_t i = 0; i < twice.colors.size() && i < single.colors.size(); i++ )
+  {
+    if( !ColorBuffer::same_color( twice.colors[i], minwin::BLACK ) )
+      drawn++;
+    if( !ColorBuffer::same_color( single.colors[i], twice.colors[i] ) )
+      different++;
+    if( single.depth[i] > 0 && twice.depth[i] > 0 && std::abs( single.depth[i] - twice.depth[i] ) > 1e-3 * twice.depth[i] )
+      deeper++;
+  }
+  const size_t cull_difference = single.culled > twice.culled ? single.culled - twice.culled : twice.culled - single.culled;
+
+  std::cout << name << ": " << float_ms << " ms/frame in float, " << double_ms << " ms/frame in double, "
+            << different << " of " << drawn << " pixels differ, " << deeper << " in depth, "
+            << single.culled << " / " << twice.culled << " of " << faces << " faces culled" << std::endl;
+
+  TestVector test_vec
+    { { "same size", single.colors.size() == twice.colors.size() }
+    , { "something drawn", drawn > 0 }
+    , { display == 0 ? "at most 1% of the pixels differ" : "at most 0.1% of the pixels differ",
+        different * ( display == 0 ? 100 : 1000 ) <= drawn }
+    , { "at most 0.1% of the pixels differ in depth", deeper * 1000 <= drawn }
+    , { "at most 2% of the faces culled differently", cull_difference * 50 <= faces } };
+
+  return run_tests( name, test_vec );
+}
+
+int main( int argc, char * argv[] )
+{
+    char default_file[] = "teapot.obj";
+    char * file_name = argc > 1 ? argv[1] : default_file;
+    int failures { 0 };
+
+    failures += compare( "wireframe", file_name, 0, 0 );
+    failures += compare( "scanline", file_name, 1, 0 );
+    failures += compare( "half-space", file_name, 1, 1 );
+    failures += compare( "tiled", file_name, 1, 2 );
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
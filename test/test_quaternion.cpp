@@ -0,0 +1,151 @@
+//
+// File       : test_quaternion.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests Quaternion class from aline library, against the Euler angle
+// matrices Object and Camera were built from.
+//
+
+#include <cmath>        // std::cos, std::sin
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "shape.h"
+
+using namespace aline;
+
+// rotation block of the former Object::transform, angles in degrees
+Mat44r euler_matrix( const Vec3r & angles )
+{
+  real r0 = angles[0] * M_PI / 180;
+  real r1 = angles[1] * M_PI / 180;
+  real r2 = angles[2] * M_PI / 180;
+  return Mat44r {
+    { cos(r1) * cos(r2), cos(r1) * sin(r2), -sin(r1), 0 },
+    { sin(r0) * sin(r1) * cos(r2) - cos(r0) * sin(r2), sin(r0) * sin(r1) * sin(r2) + cos(r0) * cos(r2), sin(r0) * cos(r1), 0 },
+    { cos(r0) * sin(r1) * cos(r2) + sin(r0) * sin(r2), cos(r0) * sin(r1) * sin(r2) - sin(r0) * cos(r2), cos(r0) * cos(r1), 0 },
+    { 0, 0, 0, 1 } };
+}
+
+// nearly_equal is relative, which rotation matrices full of zeros defeat
+template <int M, int N>
+bool close( const Matrix<real,M,N> & a, const Matrix<real,M,N> & b )
+{
+  for( int i = 0; i < M; i++ )
+    for( int j = 0; j < N; j++ )
+      if( std::abs( a[i][j] - b[i][j] ) > 1e-12 )
+        return false;
+  return true;
+}
+
+Quatr from_degrees( const Vec3r & angles )
+{
+  return from_euler( Vec3r( angles * ( M_PI / 180 ) ) );
+}
+
+int test_euler()
+{
+  std::vector<Vec3r> angles
+    { { 0, 0, 0 }, { 30, 0, 0 }, { 0, -45, 0 }, { 0, 0, 120 }
+    , { 10, 20, 30 }, { -170, 89, 45.5 }, { 360, 90, -90 } };
+
+  TestVector test_vec;
+  for( const Vec3r & a : angles )
+    test_vec.push_back( { "to_matrix( from_euler( " + to_string( a ) + " ) )",
+                          close( to_matrix( from_degrees( a ) ), euler_matrix( a ) ) } );
+  test_vec.push_back( { "identity is exact", to_matrix( from_degrees( { 0, 0, 0 } ) ) == identity<real,4>() } );
+
+  return run_tests( "from_euler", test_vec );
+}
+
+int test_operations()
+{
+  Quatr p = from_degrees( { 10, 20, 30 } );
+  Quatr q = from_axis_angle( Vec3r { 0, 0.6, 0.8 }, 1.3 );
+  Vec3r u { 1, -2, .5 };
+  Vec4r u4 { 1, -2, .5, 1 };
+  Vec4r rotated = to_matrix( q ) * u4;
+
+  TestVector test_vec
+    { { "to_matrix( p * q )", close( to_matrix( p * q ), to_matrix( p ) * to_matrix( q ) ) }
+    , { "p * conjugate( p )", close( to_matrix( p * conjugate( p ) ), identity<real,4>() ) }
+    , { "norm( p * q )", std::abs( norm( p * q ) - 1 ) < 1e-12 }
+    , { "rotate( q, u )", close( Matrix<real,1,3> { rotate( q, u ) }, Matrix<real,1,3> { { rotated[0], rotated[1], rotated[2] } } ) }
+    , { "-q is the same rotation", close( to_matrix( -q ), to_matrix( q ) ) }
+    , { "from_axis_angle( z, pi / 2 )", close( to_matrix( from_axis_angle( Vec3r { 0, 0, 1 }, M_PI / 2 ) ), rotation_z( M_PI / 2 ) ) } };
+
+  return run_tests( "Quaternion operations", test_vec );
+}
+
+int test_slerp()
+{
+  Quatr a = from_axis_angle( Vec3r { 0, 1, 0 }, .2 );
+  Quatr b = from_axis_angle( Vec3r { 0, 1, 0 }, 1.4 );
+  Quatr c = from_degrees( { 10, 20, 30 } );
+
+  TestVector test_vec
+    { { "slerp( a, b, 0 )", close( to_matrix( slerp( a, b, 0. ) ), to_matrix( a ) ) }
+    , { "slerp( a, b, 1 )", close( to_matrix( slerp( a, b, 1. ) ), to_matrix( b ) ) }
+    , { "slerp( a, b, .25 )", close( to_matrix( slerp( a, b, .25 ) ), rotation_y( .5 ) ) }
+    , { "slerp( c, -c, .5 )", close( to_matrix( slerp( c, -c, .5 ) ), to_matrix( c ) ) }
+    , { "slerp( c, c, .7 )", close( to_matrix( slerp( c, c, .7 ) ), to_matrix( c ) ) } };
+
+  return run_tests( "slerp", test_vec );
+}
+
+// the x controls turn the camera as the Euler angle increments did, and 1440
+// steps of a quarter of a degree come back to the start
+int test_camera()
+{
+  Camera camera( 1 );
+  camera.rotate_cw( 0 );
+  for( int i = 0; i < 100; i++ )
+    camera.update();
+  Mat44r after_x = camera.transform();
+  camera.rotate_acw( 0 );
+  for( int i = 0; i < 100; i++ )
+    camera.update();
+  Mat44r back = camera.transform();
+
+  camera.rotate_cw( 1 );
+  for( int i = 0; i < 1440; i++ )
+    camera.update();
+  camera.stop_rotation();
+  camera.update();
+  Mat44r turn = camera.transform();
+
+  // the anti-zoom of update() moves the camera along z while it rotates
+  TestVector test_vec
+    { { "100 steps around x", close( Matrix<real,3,3> { { after_x[0][0], after_x[0][1], after_x[0][2] }
+                                                      , { after_x[1][0], after_x[1][1], after_x[1][2] }
+                                                      , { after_x[2][0], after_x[2][1], after_x[2][2] } },
+                                     Matrix<real,3,3> { { 1, 0, 0 }
+                                                      , { 0, cos( 25 * M_PI / 180 ), sin( 25 * M_PI / 180 ) }
+                                                      , { 0, -sin( 25 * M_PI / 180 ), cos( 25 * M_PI / 180 ) } } ) }
+    , { "100 steps back", std::abs( back[1][1] - 1 ) < 1e-9 && std::abs( back[1][2] ) < 1e-9 }
+    , { "full turn around y", std::abs( turn[0][0] - 1 ) < 1e-9 && std::abs( turn[0][2] ) < 1e-9 && std::abs( turn[2][2] - 1 ) < 1e-9 } };
+
+  return run_tests( "Camera rotation", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_euler();
+    failures += test_operations();
+    failures += test_slerp();
+    failures += test_camera();
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,165 @@
+//
+// File       : test_raster.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the half-space triangle rasterizer and the tile renderer built on
+// it.
+//
+
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "halfspace.h"
+#include "tiler.h"
+
+using namespace aline;
+
+int count_pixels( const Framebuffer & fb )
+{
+  int count { 0 };
+  for( int y = 0; y < fb.get_height(); y++ )
+    for( int x = 0; x < fb.get_width(); x++ )
+      if( !Framebuffer::same_color( fb.get_pixel( x, y ), fb.get_clear_color() ) )
+        ++count;
+  return count;
+}
+
+int count_overlap( const Framebuffer & a, const Framebuffer & b )
+{
+  int count { 0 };
+  for( int y = 0; y < a.get_height(); y++ )
+    for( int x = 0; x < a.get_width(); x++ )
+      if( !Framebuffer::same_color( a.get_pixel( x, y ), a.get_clear_color() )
+       && !Framebuffer::same_color( b.get_pixel( x, y ), b.get_clear_color() ) )
+        ++count;
+  return count;
+}
+
+int test_shared_edge()
+{
+  // a 20x20 square split along its diagonal, in both windings
+  Vec2i p0 { 5, 5 };
+  Vec2i p1 { 25, 5 };
+  Vec2i p2 { 25, 25 };
+  Vec2i p3 { 5, 25 };
+
+  Framebuffer a( 40, 40 );
+  Framebuffer b( 40, 40 );
+  halfspace::fill_triangle( a, p0, 1, p1, 1, p2, 1, minwin::RED );
+  halfspace::fill_triangle( b, p0, 1, p3, 1, p2, 1, minwin::RED );
+
+  Framebuffer c( 40, 40 );
+  Framebuffer d( 40, 40 );
+  halfspace::fill_triangle( c, p0, 1, p2, 1, p1, 1, minwin::RED );
+  halfspace::fill_triangle( d, p2, 1, p3, 1, p0, 1, minwin::RED );
+
+  TestVector test_vec
+    { { "count_overlap( a, b ) == 0", count_overlap( a, b ) == 0 }
+    , { "count_pixels( a ) + count_pixels( b ) == 20 * 20", count_pixels( a ) + count_pixels( b ) == 20 * 20 }
+    , { "count_overlap( c, d ) == 0", count_overlap( c, d ) == 0 }
+    , { "count_pixels( c ) + count_pixels( d ) == 20 * 20", count_pixels( c ) + count_pixels( d ) == 20 * 20 } };
+
+  return run_tests( "fill_triangle() shared edge", test_vec );
+}
+
+int test_blocks()
+{
+  // large enough to have fully accepted, rejected and partial 8x8 blocks,
+  // and clipped by the right and bottom borders of the buffer
+  Framebuffer a( 61, 53 );
+  halfspace::fill_triangle( a, Vec2i { -10, -10 }, 1, Vec2i { 100, -10 }, 1, Vec2i { -10, 100 }, 1, minwin::RED );
+
+  // the diagonal x + y == 90 is a bottom-right edge and is left out
+  int expected { 0 };
+  for( int y = 0; y < a.get_height(); y++ )
+    for( int x = 0; x < a.get_width(); x++ )
+      if( x + y < 90 )
+        ++expected;
+
+  TestVector test_vec
+    { { "count_pixels( a ) == expected", count_pixels( a ) == expected }
+    , { "a.get_pixel( 60, 0 ) is red", Framebuffer::same_color( a.get_pixel( 60, 0 ), minwin::RED ) }
+    , { "a.get_pixel( 60, 52 ) is clear", Framebuffer::same_color( a.get_pixel( 60, 52 ), minwin::BLACK ) } };
+
+  return run_tests( "fill_triangle() blocks", test_vec );
+}
+
+int test_depth()
+{
+  Framebuffer a( 16, 16 );
+  halfspace::fill_triangle( a, Vec2i { 0, 0 }, 0.5, Vec2i { 15, 0 }, 0.5, Vec2i { 0, 15 }, 0.5, minwin::RED );
+  // farther away, must not overwrite anything
+  halfspace::fill_triangle( a, Vec2i { 0, 0 }, 0.25, Vec2i { 15, 0 }, 0.25, Vec2i { 0, 15 }, 0.25, minwin::BLUE );
+  // closer, must overwrite everything
+  halfspace::fill_triangle( a, Vec2i { 0, 0 }, 1, Vec2i { 7, 0 }, 1, Vec2i { 0, 7 }, 1, minwin::GREEN );
+
+  TestVector test_vec
+    { { "a.get_pixel( 10, 1 ) is red", Framebuffer::same_color( a.get_pixel( 10, 1 ), minwin::RED ) }
+    , { "a.get_pixel( 1, 1 ) is green", Framebuffer::same_color( a.get_pixel( 1, 1 ), minwin::GREEN ) }
+    , { "a.get_depth( 1, 1 ) == 1", a.get_depth( 1, 1 ) == 1 }
+    , { "a.get_depth( 10, 1 ) == 0.5", a.get_depth( 10, 1 ) == 0.5 } };
+
+  return run_tests( "fill_triangle() depth", test_vec );
+}
+
+int test_guard_band()
+{
+  Framebuffer a( 16, 16 );
+  bool drawn = halfspace::fill_triangle( a, Vec2i { 0, 0 }, 1, Vec2i { halfspace::GUARD_BAND, 0 }, 1, Vec2i { 0, 15 }, 1, minwin::RED );
+
+  TestVector test_vec
+    { { "not drawn", not drawn }
+    , { "count_pixels( a ) == 0", count_pixels( a ) == 0 } };
+
+  return run_tests( "fill_triangle() guard band", test_vec );
+}
+
+// a vertex far to the left stays in the guard band of every tile once
+// moved to its origin, or the triangle is left to the caller
+int test_tiler_guard_band()
+{
+  const int size = 256;
+  const int band = halfspace::GUARD_BAND - size;
+  TileRenderer<float> tiler( 64, 1 );
+  tiler.resize( size, size );
+
+  Framebuffer direct( size, size );
+  halfspace::fill_triangle( direct, Vec2i { 1 - band, 0 }, 1, Vec2i { size - 1, 0 }, 1, Vec2i { size - 1, size - 1 }, 1, minwin::RED );
+  Framebuffer tiled( size, size );
+  bool binned = tiler.add_triangle( Vec2i { 1 - band, 0 }, 1, Vec2i { size - 1, 0 }, 1, Vec2i { size - 1, size - 1 }, 1, minwin::RED );
+  tiler.flush( tiled );
+
+  Framebuffer far( size, size );
+  bool refused = !tiler.add_triangle( Vec2i { -band, 0 }, 1, Vec2i { size - 1, 0 }, 1, Vec2i { size - 1, size - 1 }, 1, minwin::RED );
+  tiler.flush( far );
+
+  TestVector test_vec
+    { { "binned", binned }
+    , { "same pixels as fill_triangle()", count_pixels( tiled ) == count_pixels( direct ) && count_overlap( tiled, direct ) == count_pixels( direct ) }
+    , { "outside the band refused", refused && count_pixels( far ) == 0 } };
+
+  return run_tests( "TileRenderer guard band", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_shared_edge();
+    failures += test_blocks();
+    failures += test_depth();
+    failures += test_guard_band();
+    failures += test_tiler_guard_band();
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
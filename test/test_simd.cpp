@@ -0,0 +1,71 @@
+//
+// File       : test_simd.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Tests the SSE/AVX kernels of simd.h against the generic templates.
+//
+
+#include <vector>       // std::vector
+#include "unit_test.h"
+#include "matrix.h"
+
+using namespace aline;
+
+// the explicit template arguments select the generic versions
+template <class T>
+int test_products( const std::string & name )
+{
+  Matrix<T,4,4> m { { 1, 2, 3, 4 }, { -.5, .25, 3, 7 }, { 0, 1, 0, -2 }, { 9, -3, .125, 1 } };
+  Matrix<T,4,4> n { { .1, 0, 1.3, -1 }, { 2, 3.7, -4, .75 }, { 1, 1, 1, 1 }, { -6, 2.5, 0, 3 } };
+  Vector<T,4> v { 3.3, 1.7, .2, 1 };
+
+  // the compiler may contract the generic loops into FMAs, so the results
+  // are compared to the last bits
+  TestVector test_vec
+    { { "m * v", nearly_equal( m * v, operator*<T,4,4>( m, v ) ) }
+    , { "n * v", nearly_equal( n * v, operator*<T,4,4>( n, v ) ) }
+    , { "m * n", nearly_equal( m * n, operator*<T,4,4,4>( m, n ) ) }
+    , { "n * m", nearly_equal( n * m, operator*<T,4,4,4>( n, m ) ) } };
+
+  return run_tests( name + " products", test_vec );
+}
+
+template <class T>
+int test_vectors( const std::string & name )
+{
+  Vector<T,4> u { 1, 2, 3, 0 };
+  Vector<T,4> v { -4, .5, 6, 0 };
+  Vector<T,4> w { .1, 7, -2.5, 3 };
+
+  TestVector test_vec
+    { { "dot( u, v )", dot( u, v ) == dot<T,4>( u, v ) }
+    , { "dot( v, w )", nearly_equal( Vector<T,1> { dot( v, w ) }, Vector<T,1> { dot<T,4>( v, w ) } ) }
+    , { "cross( u, v )", cross( u, v ) == cross<T,4>( u, v ) }
+    , { "cross( v, w )", cross( v, w ) == cross<T,4>( v, w ) }
+    , { "unit_vector( w )", nearly_equal( unit_vector( w ), unit_vector<T,4>( w ) ) } };
+
+  return run_tests( name + " dot, cross and unit_vector", test_vec );
+}
+
+int main()
+{
+    int failures { 0 };
+
+    failures += test_products<float>( "Matrix<float,4,4>" );
+    failures += test_vectors<float>( "Vector<float,4>" );
+    failures += test_products<real>( "Mat44r" );
+    failures += test_vectors<real>( "Vec4r" );
+
+    if( failures > 0 )
+    {
+        std::cout << "Total failures : " << failures << std::endl;
+        std::cout << "THE TEST FAILED!!" << std::endl;
+        return 1;
+    }
+    else
+    {
+        std::cout << "Success!" << std::endl;
+        return 0;
+    }
+}
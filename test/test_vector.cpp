@@ -10,6 +10,7 @@
 #include <limits>       // std::numeric_limits<T>::epsilon()
 #include <iostream>     // std::cout
 #include <vector>       // std::vector
+#include <type_traits>  // std::is_trivially_copyable
 #include "unit_test.h"
 #include "vector.h"
 
@@ -318,6 +319,18 @@ int test_unit_vector()
   return run_tests( "unit_vector( Vector )", test_vec );
 }
 
+// built by the compiler
+constexpr Vec3r a { 1, 2, 3 };
+constexpr Vec3r b { 4, -5, 6 };
+static_assert( a + b == Vec3r { 5, -3, 9 }, "constexpr +" );
+static_assert( a - b == Vec3r { -3, 7, -3 }, "constexpr -" );
+static_assert( -a == Vec3r { -1, -2, -3 }, "constexpr unary -" );
+static_assert( 2.0 * a == Vec3r { 2, 4, 6 } && a * 2.0 == Vec3r { 2, 4, 6 }, "constexpr scalar *" );
+static_assert( dot( a, b ) == 12, "constexpr dot" );
+
+static_assert( std::is_trivially_copyable<Vec4r>::value, "Vec4r is not trivially copyable" );
+static_assert( std::is_trivially_copyable<Vec2i>::value, "Vec2i is not trivially copyable" );
+
 int main()
 {
     int failures { 0 };
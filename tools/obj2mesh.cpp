@@ -0,0 +1,49 @@
+//
+// File       : obj2mesh.cpp
+// Licence    : see LICENCE
+// Maintainer : <your name here>
+//
+// Converts OBJ files to the binary mesh format Scene maps at start up,
+// writing file.obj.mesh next to each file.obj, whether its cache is up to
+// date or not.
+//
+// usage: obj2mesh file.obj...
+//
+
+#include <chrono>       // std::chrono::steady_clock
+#include <iostream>     // std::cout, std::cerr
+#include "mesh_cache.h"
+
+using namespace aline;
+
+int main( int argc, char * argv[] )
+{
+    if( argc < 2 )
+    {
+        std::cerr << "usage: " << argv[0] << " file.obj..." << std::endl;
+        return 1;
+    }
+
+    int failures { 0 };
+    for( int i = 1; i < argc; i++ )
+    {
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            Shape shape = build_mesh_cache( argv[i] );
+            auto end = std::chrono::steady_clock::now();
+            if( !mesh_cache_valid( argv[i] ) )
+                throw std::runtime_error( "can't write " + mesh_cache_path( argv[i] ) );
+            std::cout << argv[i] << " -> " << mesh_cache_path( argv[i] ) << ": " << shape.vertex_count() << " vertices, "
+                      << shape.face_count() << " faces, " << std::chrono::duration<double, std::milli>( end - start ).count()
+                      << " ms" << std::endl;
+        }
+        catch( const std::exception & e )
+        {
+            std::cerr << argv[i] << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}